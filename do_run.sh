@@ -6,5 +6,5 @@ set -e
 readonly DIRNAME="$(realpath "$(dirname "${0}")")"
 
 cd "${DIRNAME}"/cmake-build
-./3D_object_tracking
+./3D_object_tracking "$@"
 
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdexcept>
+
+#include "DeadlineScheduler.hpp"
+
+using namespace std;
+
+
+DeadlineScheduler::DeadlineScheduler(double budgetMs) : budgetMs_(budgetMs)
+{
+  if (budgetMs_ < 0.0)
+  {
+    throw invalid_argument("the frame budget must not be negative");
+  }
+}
+
+bool DeadlineScheduler::frameDone(const StageTimer& timer)
+{
+  double frameMs = 0.0, estimateMs = 0.0;
+  for (size_t stage = 0; stage < num_of_stages; ++stage)
+  {
+    const double ms = timer.ms(static_cast<Stage>(stage));
+    stageEstimateMs_[stage] = frames_ == 0 ? ms : (1.0 - kSmoothing) * stageEstimateMs_[stage] + kSmoothing * ms;
+    if (stage != stage_LOAD)
+    {
+      frameMs += ms;
+      estimateMs += stageEstimateMs_[stage];
+    }
+  }
+  ++frames_;
+
+  if (budgetMs_ == 0.0)
+  {
+    return false;
+  }
+
+  const bool missed = frameMs > budgetMs_;
+  deadlineMisses_ += missed ? 1 : 0;
+  ++framesAtLevel_;
+
+  // the gap between the two thresholds and the delays keep the level from oscillating
+  if (estimateMs > kRiskRatio * budgetMs_ or missed)
+  {
+    framesWithHeadroom_ = 0;
+    if (level_ + 1 < static_cast<int>(num_of_degradations) and framesAtLevel_ >= kSettleFrames)
+    {
+      level_ = static_cast<Degradation>(level_ + 1);
+      framesAtLevel_ = 0;
+    }
+  }
+  else if (estimateMs < kHeadroomRatio * budgetMs_)
+  {
+    if (++framesWithHeadroom_ >= kRestoreFrames and level_ > degradation_NONE)
+    {
+      level_ = static_cast<Degradation>(level_ - 1);
+      framesAtLevel_ = 0;
+      framesWithHeadroom_ = 0;
+    }
+  }
+  else
+  {
+    framesWithHeadroom_ = 0;
+  }
+  return missed;
+}
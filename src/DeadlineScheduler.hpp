@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_DEADLINESCHEDULER_HPP
+#define CAMERA_FUSION_DEADLINESCHEDULER_HPP
+
+#include <cstddef>
+
+#include "dataStructures.h"
+#include "ResultsSink.hpp"
+
+
+/* a list of the quality degradation steps, in the order they are applied; every level includes the previous ones */
+#define DEGRADATIONS(action, arg, sep)         \
+        action(arg, NONE)                  sep \
+        action(arg, CAP_KEYPOINTS)         sep \
+        action(arg, SUBSAMPLE_LIDAR)       sep \
+        action(arg, PROPAGATE_BOXES)       sep \
+        action(arg, EGO_LANE_TTC)
+DECLARE_VARIABLES(DEGRADATIONS, degradation, Degradation);
+
+// keeps the processing of a frame within a time budget by degrading the quality step by step whenever the
+// smoothed latency of the frames approaches the budget, and restoring it once there is enough headroom again;
+// the load stage is not counted against the budget, as it includes waiting for the sensors
+class DeadlineScheduler
+{
+public:
+
+  // a budget of 0 disables the scheduler: the level stays at degradation_NONE
+  explicit DeadlineScheduler(double budgetMs);
+
+  Degradation level() const { return level_; }
+
+  // true if the given step is applied at the current level
+  bool degraded(Degradation step) const { return level_ >= step; }
+
+  // accounts for the stage latencies of a processed frame and adjusts the level for the next frame;
+  // returns true if the frame has missed its deadline
+  bool frameDone(const StageTimer& timer);
+
+  size_t frames() const { return frames_; }
+  size_t deadlineMisses() const { return deadlineMisses_; }
+
+  // smoothed latency of the stage in milliseconds
+  double stageEstimateMs(Stage stage) const { return stageEstimateMs_[stage]; }
+
+private:
+
+  static constexpr double kSmoothing = 0.3;      // weight of the latest frame in the smoothed latencies
+  static constexpr double kRiskRatio = 0.9;      // the budget is at risk above this fraction of it
+  static constexpr double kHeadroomRatio = 0.6;  // there is headroom below this fraction of the budget
+  static constexpr size_t kSettleFrames = 3;     // no. of frames a new level runs before the next degradation
+  static constexpr size_t kRestoreFrames = 10;   // no. of consecutive frames with headroom before a restoration
+
+  const double budgetMs_;
+  Degradation level_ = degradation_NONE;
+  double stageEstimateMs_[num_of_stages] = {};
+  size_t frames_ = 0;
+  size_t deadlineMisses_ = 0;
+  size_t framesAtLevel_ = 0;
+  size_t framesWithHeadroom_ = 0;
+};
+
+#endif //CAMERA_FUSION_DEADLINESCHEDULER_HPP
@@ -5,8 +5,16 @@
 #include <sstream>
 #include <iomanip>
 #include <vector>
+#include <deque>
+#include <map>
+#include <string>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -20,361 +28,1139 @@
 #include "objectDetection2D.hpp"
 #include "lidarData.hpp"
 #include "camFusion.hpp"
+#include "TrackManager.hpp"
+#include "LidarIndex.hpp"
+#include "FrameSource.hpp"
+#include "Options.hpp"
+#include "Sweep.hpp"
+#include "ResultsSink.hpp"
+#include "DeadlineScheduler.hpp"
+#include "ResourcePool.hpp"
+#include "ThreadBudget.hpp"
+#include "KltTracker.hpp"
 
 using namespace std;
 
 
 constexpr bool kSingleRunFlag = true;
-constexpr struct {
-    Detector detector = detector_SHITOMASI;
-    Descriptor descriptor = descriptor_ORB;
-    DescriptorType descriptor_type = descriptor_type_BINARY;
-    Matcher matcher = matcher_BF;
-    Selector selector = selector_NN;
-} kSingleRunConfig;
+constexpr PipelineConfig kSingleRunConfig{
+    detector_SHITOMASI, descriptor_ORB, descriptor_type_BINARY, matcher_BF, selector_NN,
+};
 
+// minimum intersection over union between a box found by the tiny YOLO model and a box tracked from the previous
+// frame for them to be considered the same object in the cascade detection mode
+constexpr double kCascadeMinIoU = 0.5;
 
+// minimum number of keypoint matches a bounding box must enclose to be propagated into the next frame
+// without running the object detector
+constexpr size_t kMinPropagationSupport = 10;
 
-/* MAIN PROGRAM */
-int main(int, const char*[])
-{
-    /* INIT VARIABLES AND DATA STRUCTURES */
+// ground removal: the lower crop bound lies well below the road surface (the sensor is mounted ~1.73 m above it),
+// and the points closer than kGroundDistanceTol to the estimated plane are considered to be the ground
+constexpr float kGroundCropMinZ = -3.0;
+constexpr int kGroundRansacIterations = 100;
+constexpr float kGroundDistanceTol = 0.2;
 
-    // data location
-    string dataPath = "../";
+// edge length in pixels of the cells of the Lidar depth image
+constexpr int kLidarDepthCellSize = 4;
 
-    // camera
-    string imgBasePath = dataPath + "images/";
-    string imgPrefix = "KITTI/2011_09_26/image_02/data/000000"; // left camera, color
-    string imgFileType = ".png";
-    int imgStartIndex = 0; // first file index to load (assumes Lidar and camera names have identical naming convention)
-    int imgEndIndex = 18;   // last file index to load
-    int imgStepWidth = 1; 
-    int imgFillWidth = 4;  // no. of digits which make up the file index (e.g. img-0001.png)
+// quality degradation under the frame deadline: max. no. of keypoints per frame and the edge length of the voxels
+// the cropped Lidar cloud is subsampled with
+constexpr size_t kDegradedMaxKeypoints = 300;
+constexpr float kDegradedVoxelSize = 0.2;
 
-    // object detection
-    string yoloBasePath = dataPath + "dat/yolo/";
-    string yoloClassesFile = yoloBasePath + "coco.names";
-    string yoloModelConfiguration = yoloBasePath + "yolov3.cfg";
-    string yoloModelWeights = yoloBasePath + "yolov3.weights";
+// KLT tracking mode: the keypoints are detected anew once fewer than kKltMinTrackedKeypoints of them are tracked,
+// and a track is dropped if tracking it back misses its origin by more than kKltMaxForwardBackwardError pixels
+constexpr size_t kKltMinTrackedKeypoints = 500;
+constexpr float kKltMaxForwardBackwardError = 1.0;
 
-    // Lidar
-    string lidarPrefix = "KITTI/2011_09_26/velodyne_points/data/000000";
-    string lidarFileType = ".bin";
+// guided matching: a keypoint is matched only with the keypoints within kGuidedSearchRadius pixels of its predicted
+// position; the motion of a box (or of the background) is estimated from at least kGuidedMinMotionSupport matches
+constexpr float kGuidedSearchRadius = 40.0;
+constexpr size_t kGuidedMinMotionSupport = 10;
+
+
+// settings shared by all the sequences and combinations a run processes
+struct RunSettings
+{
+    // frames
+    std::string frameSourceName;
+    size_t streamBufferFrames;
+    std::string imgFileType;
+    std::string lidarFileType;
+    int imgStartIndex;
+    int imgStepWidth;
+
+    // object detection
+    cv::Size yoloInputSize;
+    std::vector<std::string> yoloClasses;
+    float confThreshold;
+    float nmsThreshold;
+    bool bCascade;
+    int cascadePeriod;
+    int detectionPeriod;
+    size_t detectionBatchSize; // frames passed through the network at once, more than one reads the frames ahead
+
+    // Lidar and TTC
+    bool bFusion;
+    size_t maxLidarPoints;
+    size_t maxMatchPairs;
+    bool bGroundRemoval;
+    float voxelSize;
+    float lidarClusterTolerance;
+    double frameBudgetMs;
+
+    bool bKltTracking; // track the keypoints with the optical flow instead of matching their descriptors
+    bool bGuidedMatching; // match the descriptors only around the keypoint positions predicted from the motion
+    bool bSingleRun; // visualize results
 
     // calibration data for camera and lidar
-    cv::Mat P_rect_00(3,4,cv::DataType<double>::type); // 3x4 projection matrix after rectification
-    cv::Mat R_rect_00(4,4,cv::DataType<double>::type); // 3x3 rectifying rotation to make image planes co-planar
-    cv::Mat RT(4,4,cv::DataType<double>::type); // rotation matrix and translation vector
-    
-    RT.at<double>(0,0) = 7.533745e-03; RT.at<double>(0,1) = -9.999714e-01; RT.at<double>(0,2) = -6.166020e-04; RT.at<double>(0,3) = -4.069766e-03;
-    RT.at<double>(1,0) = 1.480249e-02; RT.at<double>(1,1) = 7.280733e-04; RT.at<double>(1,2) = -9.998902e-01; RT.at<double>(1,3) = -7.631618e-02;
-    RT.at<double>(2,0) = 9.998621e-01; RT.at<double>(2,1) = 7.523790e-03; RT.at<double>(2,2) = 1.480755e-02; RT.at<double>(2,3) = -2.717806e-01;
-    RT.at<double>(3,0) = 0.0; RT.at<double>(3,1) = 0.0; RT.at<double>(3,2) = 0.0; RT.at<double>(3,3) = 1.0;
-    
-    R_rect_00.at<double>(0,0) = 9.999239e-01; R_rect_00.at<double>(0,1) = 9.837760e-03; R_rect_00.at<double>(0,2) = -7.445048e-03; R_rect_00.at<double>(0,3) = 0.0;
-    R_rect_00.at<double>(1,0) = -9.869795e-03; R_rect_00.at<double>(1,1) = 9.999421e-01; R_rect_00.at<double>(1,2) = -4.278459e-03; R_rect_00.at<double>(1,3) = 0.0;
-    R_rect_00.at<double>(2,0) = 7.402527e-03; R_rect_00.at<double>(2,1) = 4.351614e-03; R_rect_00.at<double>(2,2) = 9.999631e-01; R_rect_00.at<double>(2,3) = 0.0;
-    R_rect_00.at<double>(3,0) = 0; R_rect_00.at<double>(3,1) = 0; R_rect_00.at<double>(3,2) = 0; R_rect_00.at<double>(3,3) = 1;
-    
-    P_rect_00.at<double>(0,0) = 7.215377e+02; P_rect_00.at<double>(0,1) = 0.000000e+00; P_rect_00.at<double>(0,2) = 6.095593e+02; P_rect_00.at<double>(0,3) = 0.000000e+00;
-    P_rect_00.at<double>(1,0) = 0.000000e+00; P_rect_00.at<double>(1,1) = 7.215377e+02; P_rect_00.at<double>(1,2) = 1.728540e+02; P_rect_00.at<double>(1,3) = 0.000000e+00;
-    P_rect_00.at<double>(2,0) = 0.000000e+00; P_rect_00.at<double>(2,1) = 0.000000e+00; P_rect_00.at<double>(2,2) = 1.000000e+00; P_rect_00.at<double>(2,3) = 0.000000e+00;
+    cv::Mat P_rect_00; // 3x4 projection matrix after rectification
+    cv::Mat R_rect_00; // 3x3 rectifying rotation to make image planes co-planar
+    cv::Mat RT;        // rotation matrix and translation vector
+};
 
-    for (auto e_detector : detector_array) {
-        for (auto e_descriptor : descriptor_array) {
-            if ((e_descriptor == descriptor_AKAZE && e_detector != detector_AKAZE) ||
-                (e_descriptor == descriptor_ORB && e_detector == detector_SIFT)) {
-                // AKAZE descriptor extractor works only with key-points detected with KAZE/AKAZE detectors
-                // see https://docs.opencv.org/3.0-beta/modules/features2d/doc/feature_detection_and_description.html#akaze
+// a single recording and the files its results go to
+struct SequenceRun
+{
+    std::string name;
+    std::string imgPrefix;   // full path of the images up to the file index
+    std::string lidarPrefix; // full path of the Lidar scans up to the file index
+    int imgEndIndex;
+    int imgFillWidth;
+    std::string ttcPath;       // TTC table
+    std::string resultsPrefix; // results records, <prefix>.results and <prefix>.csv
+};
+
+// instances of the object detection networks used together by a single sequence at a time
+struct DetectorNets
+{
+    cv::dnn::Net yoloNet;     // selected model
+    cv::dnn::Net yoloTinyNet; // fast path of the cascade, empty if the cascade is off
+};
+
+// processes a whole sequence with the given combination of keypoint algorithms; the networks are checked out
+// of the pool only for the detections, so that several sequences can share fewer networks; the TTC and the frame
+// latencies are accounted for in sweepScore, if given
+static void runSequence(const RunSettings& settings, const SequenceRun& sequence, const PipelineConfig& config,
+                        ResourcePool<DetectorNets>& netPool, KeypointPipeline& keypointPipeline,
+                        SweepScore* sweepScore = nullptr)
+{
+    const Detector e_detector = config.detector;
+
+    // misc
+    double sensorFrameRate = 10.0 / settings.imgStepWidth; // frames per second for Lidar and camera
+    const size_t dataBufferSize = 2;       // no. of images which are held in memory (ring buffer) at the same time
+    CircularBuffer<DataFrame, dataBufferSize> dataBuffer; // list of data frames which are held in memory at the same time
+    bool bVis = settings.bSingleRun;                // visualize results
+
+    std::ofstream ttc_ofs{sequence.ttcPath, std::ios::out};
+    ttc_ofs << "image_id ttc_lidar ttc_camera" << (settings.bFusion ? " ttc_fused\n" : "\n");
+
+    // per-frame, per-track records with the stage latencies, written in the background and exported
+    // to CSV once the sequence is done
+    ResultsSink resultsSink{sequence.resultsPrefix + ".results"};
+    StageTimer stageTimer;
+    std::vector<ResultRecord> frameResults;
+
+    // quality level of the frames, adjusted to their latencies
+    DeadlineScheduler scheduler{settings.frameBudgetMs};
+
+    // frames (with their indices) which have been read ahead and passed through the network
+    // in the batched mode
+    std::deque<std::pair<int, DataFrame>> detectedFrames;
+
+    // number of frames processed by the tiny model only since the last full detection
+    int framesSinceFullDetection = 0;
+
+    // number of frames whose bounding boxes have been propagated since the last detection
+    int framesSinceDetection = 0;
+
+    // persistent identities of the objects across the frames of the sequence
+    TrackManager trackManager;
+
+    // optical flow tracking of the keypoints in the KLT mode
+    KltTracker kltTracker{keypointPipeline, kKltMinTrackedKeypoints, kKltMaxForwardBackwardError};
+
+    // camera images and Lidar scans of the sequence, either from the numbered files or streamed
+    const auto frameSource = makeFrameSource(settings.frameSourceName, settings.streamBufferFrames,
+                                             sequence.imgPrefix, settings.imgFileType,
+                                             sequence.lidarPrefix, settings.lidarFileType,
+                                             settings.imgStartIndex, sequence.imgEndIndex,
+                                             settings.imgStepWidth, sequence.imgFillWidth);
+    SensorFrame sensorFrame;
+
+    /* MAIN LOOP OVER ALL IMAGES */
+
+    while (true) {
+        /* LOAD IMAGE INTO BUFFER */
+
+        stageTimer.start();
+
+        int imgIndex;
+        if (settings.detectionBatchSize > 1)
+        {
+            if (detectedFrames.empty())
+            {
+                // read the next batch of frames starting from the current one
+                vector<cv::Mat> batchImgs;
+                vector<SensorFrame> batchFrames;
+                while (batchFrames.size() < settings.detectionBatchSize and frameSource->next(sensorFrame))
+                {
+                    batchImgs.push_back(sensorFrame.cameraImg);
+                    batchFrames.push_back(std::move(sensorFrame));
+                }
+                if (batchFrames.empty())
+                {
+                    break; // end of the sequence
+                }
 
-                // ORB descriptor extractor does not work with the SIFT detetor
-                // see https://answers.opencv.org/question/5542/sift-feature-descriptor-doesnt-work-with-orb-keypoinys/
-                continue;
+                vector<vector<BoundingBox>> batchBoxes;
+                {
+                    const auto nets = netPool.checkout();
+                    detectObjectsBatch(batchImgs, batchBoxes, nets->yoloNet, settings.yoloInputSize,
+                                       settings.confThreshold, settings.nmsThreshold);
+                }
+
+                for (size_t i = 0; i < batchFrames.size(); ++i)
+                {
+                    DataFrame batchFrame;
+                    batchFrame.cameraImg = batchImgs[i];
+                    batchFrame.images = FrameImages(batchFrame.cameraImg);
+                    batchFrame.lidarPoints = std::move(batchFrames[i].lidarPoints);
+                    batchFrame.boundingBoxes = std::move(batchBoxes[i]);
+                    detectedFrames.emplace_back(batchFrames[i].index, std::move(batchFrame));
+                }
             }
 
-            for (auto e_descriptor_type : CompatibleDescriptorTypes(e_descriptor)) {
-                for (auto e_matcher : matcher_array) {
-                    for (auto e_selector : selector_array) {
-
-                        if (kSingleRunFlag)
-                        {
-                            e_detector = kSingleRunConfig.detector;
-                            e_descriptor = kSingleRunConfig.descriptor;
-                            e_descriptor_type = kSingleRunConfig.descriptor_type;
-                            e_matcher = kSingleRunConfig.matcher;
-                            e_selector = kSingleRunConfig.selector;
-                        }
+            // push the already processed frame into data frame buffer
+            imgIndex = detectedFrames.front().first;
+            dataBuffer.push_back(detectedFrames.front().second);
+            detectedFrames.pop_front();
+        }
+        else
+        {
+            // load image and Lidar scan
+            if (not frameSource->next(sensorFrame))
+            {
+                break; // end of the sequence
+            }
+            imgIndex = sensorFrame.index;
+
+            // push image into data frame buffer
+            DataFrame frame;
+            frame.cameraImg = sensorFrame.cameraImg;
+            frame.images = FrameImages(frame.cameraImg);
+            frame.lidarPoints = std::move(sensorFrame.lidarPoints);
+            dataBuffer.push_back(frame);
+        }
 
-                        // misc
-                        double sensorFrameRate = 10.0 / imgStepWidth; // frames per second for Lidar and camera
-                        const size_t dataBufferSize = 2;       // no. of images which are held in memory (ring buffer) at the same time
-                        CircularBuffer<DataFrame, dataBufferSize> dataBuffer; // list of data frames which are held in memory at the same time
-                        bool bVis = kSingleRunFlag;            // visualize results
-                        std::ostringstream oss;
-                        oss << ToString(e_detector) << '_'
-                            << ToString(e_descriptor) << '_'
-                            << ToString(e_descriptor_type) << '_'
-                            << ToString(e_matcher) << '_'
-                            << ToString(e_selector);
+        stageTimer.lap(stage_LOAD);
 
-                        std::string unique_prefix = oss.str();
 
+        /* DETECT IMAGE KEYPOINTS */
 
-                        std::cout << "\n\n\n\n" << unique_prefix << std::endl;
+        // convert current image to grayscale, once for the detection, the description and the tracking
+        cv::Mat imgGray = (dataBuffer.end() - 1)->images.gray();
 
-                        std::ofstream ttc_ofs{unique_prefix + ".txt", std::ios::out};
-                        ttc_ofs << "image_id ttc_lidar ttc_camera\n";
+        // extract 2D keypoints from current image, or track the previous image's ones in the KLT mode
+        vector<cv::KeyPoint> keypoints; // create empty feature list for current image
+        vector<cv::DMatch> trackedMatches;
+        if (settings.bKltTracking and dataBuffer.size() > 1) {
+            kltTracker.track((dataBuffer.end() - 2)->images, (dataBuffer.end() - 1)->images,
+                             (dataBuffer.end() - 2)->keypoints, keypoints, trackedMatches);
+        } else {
+            keypointPipeline.detect(imgGray, keypoints);
+        }
 
-                        /* MAIN LOOP OVER ALL IMAGES */
+        // optional : limit number of keypoints (helpful for debugging and learning);
+        // the number is limited as well when the frame deadline is at risk, unless the matches of the tracked
+        // keypoints refer to them
+        bool bLimitKpts = false;
+        size_t maxKeypoints = bLimitKpts ? 50 : 0;
+        if (scheduler.degraded(degradation_CAP_KEYPOINTS) and not bLimitKpts) {
+            maxKeypoints = kDegradedMaxKeypoints;
+        }
+        if (maxKeypoints > 0 and keypoints.size() > maxKeypoints and trackedMatches.empty()) {
 
-                        for (int imgIndex = 0; imgIndex <= imgEndIndex - imgStartIndex; imgIndex += imgStepWidth) {
-                            /* LOAD IMAGE INTO BUFFER */
+            if (e_detector == detector_SHITOMASI) { // there is no response info, so keep the first ones as they are sorted in descending quality order
+                keypoints.erase(keypoints.begin() + maxKeypoints, keypoints.end());
+            }
+            cv::KeyPointsFilter::retainBest(keypoints, static_cast<int>(maxKeypoints));
+            if (bLimitKpts) {
+                cout << " NOTE: Keypoints have been limited!" << endl;
+            }
+        }
 
-                            // assemble filenames for current index
-                            ostringstream imgNumber;
-                            imgNumber << setfill('0') << setw(imgFillWidth) << imgStartIndex + imgIndex;
-                            string imgFullFilename = imgBasePath + imgPrefix + imgNumber.str() + imgFileType;
+        // push keypoints and descriptor for current frame to end of data buffer
+        (dataBuffer.end() - 1)->keypoints = keypoints;
 
-                            // load image from file
-                            cv::Mat img = cv::imread(imgFullFilename);
+        stageTimer.lap(stage_DETECT_KEYPOINTS);
 
-                            // push image into data frame buffer
-                            DataFrame frame;
-                            frame.cameraImg = img;
-                            dataBuffer.push_back(frame);
 
-                            cout << "#1 : LOAD IMAGE INTO BUFFER done" << endl;
+        /* EXTRACT KEYPOINT DESCRIPTORS */
 
+        // the tracked keypoints need no descriptors
+        if (not settings.bKltTracking) {
+            cv::Mat descriptors;
+            keypointPipeline.describe((dataBuffer.end() - 1)->keypoints, imgGray, descriptors);
 
-                            /* DETECT & CLASSIFY OBJECTS */
+            // push descriptors for current frame to end of data buffer
+            (dataBuffer.end() - 1)->descriptors = descriptors;
+        }
 
-                            float confThreshold = 0.2;
-                            float nmsThreshold = 0.4;
-                            detectObjects((dataBuffer.end() - 1)->cameraImg, (dataBuffer.end() - 1)->boundingBoxes,
-                                          confThreshold, nmsThreshold,
-                                          yoloBasePath, yoloClassesFile, yoloModelConfiguration, yoloModelWeights,
-                                          bVis);
+        stageTimer.lap(stage_DESCRIBE_KEYPOINTS);
 
-                            cout << "#2 : DETECT & CLASSIFY OBJECTS done" << endl;
 
+        if (dataBuffer.size() > 1) // wait until at least two images have been processed
+        {
 
-                            /* CROP LIDAR POINTS */
+            /* MATCH KEYPOINT DESCRIPTORS */
 
-                            // load 3D Lidar points from file
-                            string lidarFullFilename = imgBasePath + lidarPrefix + imgNumber.str() + lidarFileType;
-                            std::vector<LidarPoint> lidarPoints;
-                            loadLidarFromFile(lidarPoints, lidarFullFilename);
+            vector<cv::DMatch> matches;
+            if (settings.bKltTracking) {
+                matches = std::move(trackedMatches);
+            } else if (settings.bGuidedMatching and not (dataBuffer.end() - 2)->predictedKeypoints.empty()) {
+                keypointPipeline.matchGuided((dataBuffer.end() - 2)->predictedKeypoints,
+                                             (dataBuffer.end() - 1)->keypoints, kGuidedSearchRadius,
+                                             (dataBuffer.end() - 2)->descriptors,
+                                             (dataBuffer.end() - 1)->descriptors, matches);
+            } else {
+                keypointPipeline.match((dataBuffer.end() - 2)->descriptors, (dataBuffer.end() - 1)->descriptors,
+                                        matches);
+            }
 
-                            // remove Lidar points based on distance properties
-                            float minZ = -1.5, maxZ = -0.9, minX = 2.0, maxX = 20.0, maxY = 2.0, minR = 0.1; // focus on ego lane
-                            cropLidarPoints(lidarPoints, minX, maxX, maxY, minZ, maxZ, minR);
+            // store matches in current data frame
+            (dataBuffer.end() - 1)->kptMatches = matches;
 
-                            (dataBuffer.end() - 1)->lidarPoints = lidarPoints;
+        }
+
+        stageTimer.lap(stage_MATCH_KEYPOINTS);
+
+
+        /* DETECT & CLASSIFY OBJECTS */
+
+        if (settings.detectionBatchSize <= 1)
+        {
+            cv::Mat& currImg = (dataBuffer.end() - 1)->cameraImg;
+            vector<BoundingBox>& currBoxes = (dataBuffer.end() - 1)->boundingBoxes;
+
+            // between two detections, carry the boxes over from the previous frame using
+            // the keypoint matches, unless some box has lost too much keypoint support
+            // (on every frame when the frame deadline is at risk)
+            bool bRunDetector = true;
+            if (dataBuffer.size() > 1 and
+                (framesSinceDetection + 1 < settings.detectionPeriod or
+                 scheduler.degraded(degradation_PROPAGATE_BOXES)))
+            {
+                bRunDetector = not propagateBoundingBoxes(
+                        (dataBuffer.end() - 2)->boundingBoxes,
+                        (dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
+                        (dataBuffer.end() - 1)->kptMatches, currBoxes, kMinPropagationSupport);
+            }
+
+            // the networks are shared with the other sequences processed at the same time
+            ResourcePool<DetectorNets>::Lease nets;
+            if (bRunDetector)
+            {
+                nets = netPool.checkout();
+            }
+
+            bool bRunFullModel = bRunDetector;
+            if (bRunDetector and settings.bCascade and dataBuffer.size() > 1 and
+                framesSinceFullDetection + 1 < settings.cascadePeriod)
+            {
+                // fast path: keep the tiny model's boxes unless they do not agree with the boxes
+                // of the previous frame; when the full model is due anyway, the tiny model is skipped
+                currBoxes.clear();
+                detectObjects(currImg, currBoxes, nets->yoloTinyNet, settings.yoloInputSize,
+                              settings.confThreshold, settings.nmsThreshold);
+                bRunFullModel = boxesDisagree(currBoxes, (dataBuffer.end() - 2)->boundingBoxes, kCascadeMinIoU);
+            }
+
+            if (bRunFullModel)
+            {
+                currBoxes.clear();
+                detectObjects(currImg, currBoxes, nets->yoloNet, settings.yoloInputSize,
+                              settings.confThreshold, settings.nmsThreshold);
+                framesSinceFullDetection = 0;
+            }
+            else if (bRunDetector)
+            {
+                ++framesSinceFullDetection;
+            }
+            framesSinceDetection = bRunDetector ? 0 : framesSinceDetection + 1;
+            nets.reset();
+
+            if (bVis)
+            {
+                showDetectedObjects(currImg, currBoxes, settings.yoloClasses);
+            }
+        }
+
+        stageTimer.lap(stage_DETECT_OBJECTS);
+
+
+        /* CROP LIDAR POINTS */
+
+        // 3D Lidar points have been loaded together with the image
+        std::vector<LidarPoint> lidarPoints = std::move((dataBuffer.end() - 1)->lidarPoints);
+
+        // remove Lidar points based on distance properties
+        float minZ = -1.5, maxZ = -0.9, minX = 2.0, maxX = 20.0, maxY = 2.0, minR = 0.1; // focus on ego lane
+        const float fixedMinZ = minZ;
+        if (settings.bGroundRemoval)
+        {
+            // the crop keeps the ground, which is then estimated and removed
+            minZ = kGroundCropMinZ;
+        }
+        cropLidarPoints(lidarPoints, minX, maxX, maxY, minZ, maxZ, minR);
+
+        if (settings.bGroundRemoval and
+            not removeGroundPoints(lidarPoints, kGroundRansacIterations, kGroundDistanceTol))
+        {
+            // no road plane has been found, so the ground is cut off with the fixed lower bound after all
+            cropLidarPoints(lidarPoints, minX, maxX, maxY, fixedMinZ, maxZ, minR);
+        }
+        const float lidarVoxelSize = scheduler.degraded(degradation_SUBSAMPLE_LIDAR) ?
+                                     std::max(settings.voxelSize, kDegradedVoxelSize) : settings.voxelSize;
+        if (lidarVoxelSize > 0.0f)
+        {
+            downsampleLidarPoints(lidarPoints, lidarVoxelSize);
+        }
+
+        (dataBuffer.end() - 1)->lidarPoints = lidarPoints;
 
-                            cout << "#3 : CROP LIDAR POINTS done" << endl;
+        // project the cropped cloud into the image once; the depth image serves all the
+        // subsequent point-in-ROI and depth-at-pixel queries of the frame
+        projectLidarPoints((dataBuffer.end() - 1)->lidarPoints, settings.P_rect_00, settings.R_rect_00, settings.RT,
+                           (dataBuffer.end() - 1)->cameraImg.size(), kLidarDepthCellSize,
+                           (dataBuffer.end() - 1)->lidarDepth);
 
+        stageTimer.lap(stage_CROP_LIDAR);
 
-                            /* CLUSTER LIDAR POINT CLOUD */
 
-                            // associate Lidar points with camera-based ROI
-                            float shrinkFactor = 0.2; // shrinks each bounding box by the given percentage to avoid 3D object merging at the edges of an ROI
-                            clusterLidarWithROI((dataBuffer.end() - 1)->boundingBoxes,
-                                                (dataBuffer.end() - 1)->lidarPoints,
-                                                shrinkFactor, P_rect_00, R_rect_00, RT);
+        /* CLUSTER LIDAR POINT CLOUD */
 
-                            // Visualize 3D objects
-                            bVis = kSingleRunFlag;
-                            if (bVis) {
-                                show3DObjects((dataBuffer.end() - 1)->boundingBoxes, cv::Size(4.0, 20.0),
-                                              cv::Size(2000, 2000), imgIndex, true);
-                            }
-                            bVis = false;
+        // associate Lidar points with camera-based ROI
+        float shrinkFactor = 0.2; // shrinks each bounding box by the given percentage to avoid 3D object merging at the edges of an ROI
+        clusterLidarWithROI((dataBuffer.end() - 1)->boundingBoxes,
+                            (dataBuffer.end() - 1)->lidarPoints,
+                            (dataBuffer.end() - 1)->lidarDepth, shrinkFactor);
 
-                            cout << "#4 : CLUSTER LIDAR POINT CLOUD done" << endl;
+        if (settings.lidarClusterTolerance > 0.0f)
+        {
+            // the index is built once over the whole cropped cloud and shared by all the boxes
+            const LidarIndex lidarIndex((dataBuffer.end() - 1)->lidarPoints, settings.lidarClusterTolerance);
+            removeLidarOutliers((dataBuffer.end() - 1)->boundingBoxes, lidarIndex,
+                                settings.lidarClusterTolerance);
+        }
 
-                            /* DETECT IMAGE KEYPOINTS */
+        // the distance to every object is summarized once, and serves the TTC of this and of the next frame pair
+        computeLidarRangeStats((dataBuffer.end() - 1)->boundingBoxes, (dataBuffer.end() - 1)->lidarPoints,
+                               settings.maxLidarPoints);
+
+        // the previous frame's boxes carry their range statistics, so its cloud is no longer needed
+        if (dataBuffer.size() > 1)
+        {
+            DataFrame &prevFrame = *(dataBuffer.end() - 2);
+            std::vector<LidarPoint>().swap(prevFrame.lidarPoints);
+            prevFrame.lidarDepth = DepthImage();
+            for (auto &box : prevFrame.boundingBoxes)
+            {
+                std::vector<size_t>().swap(box.lidarPointIndices);
+            }
+        }
 
-                            // convert current image to grayscale
-                            cv::Mat imgGray;
-                            cv::cvtColor((dataBuffer.end() - 1)->cameraImg, imgGray, cv::COLOR_BGR2GRAY);
+        // Visualize 3D objects
+        bVis = settings.bSingleRun;
+        if (bVis) {
+            show3DObjects((dataBuffer.end() - 1)->boundingBoxes, (dataBuffer.end() - 1)->lidarPoints,
+                          cv::Size(4.0, 20.0), cv::Size(2000, 2000), imgIndex, true);
+        }
+        bVis = false;
 
-                            // extract 2D keypoints from current image
-                            vector<cv::KeyPoint> keypoints; // create empty feature list for current image
-                            string detectorType = ToString(e_detector);
+        stageTimer.lap(stage_CLUSTER_LIDAR);
+
+
+        if (dataBuffer.size() == 1)
+        {
+            // the objects of the first frame start new tracks
+            trackManager.update(nullptr, *(dataBuffer.end() - 1));
+            stageTimer.lap(stage_TRACK_OBJECTS);
+        }
+        else // wait until at least two images have been processed
+        {
 
-                            if (detectorType == "SHITOMASI") {
-                                detKeypointsShiTomasi(keypoints, imgGray, false);
-                            } else if (detectorType == "HARRIS") {
-                                detKeypointsHarris(keypoints, imgGray, bVis);
-                            } else {
-                                detKeypointsModern(keypoints, imgGray, detectorType, bVis);
-                            }
+            /* TRACK 3D OBJECT BOUNDING BOXES */
 
-                            // optional : limit number of keypoints (helpful for debugging and learning)
-                            bool bLimitKpts = false;
-                            if (bLimitKpts) {
-                                int maxKeypoints = 50;
+            // associate bounding boxes between current and previous frame using keypoint matches
+            map<int, int> bbBestMatches;
+            matchBoundingBoxes((dataBuffer.end() - 1)->kptMatches, bbBestMatches,
+                               *(dataBuffer.end() - 2), *(dataBuffer.end() - 1));
 
-                                if (detectorType.compare("SHITOMASI") ==
-                                    0) { // there is no response info, so keep the first 50 as they are sorted in descending quality order
-                                    keypoints.erase(keypoints.begin() + maxKeypoints, keypoints.end());
-                                }
-                                cv::KeyPointsFilter::retainBest(keypoints, maxKeypoints);
-                                cout << " NOTE: Keypoints have been limited!" << endl;
-                            }
+            // store matches in current data frame
+            (dataBuffer.end() - 1)->bbMatches = bbBestMatches;
 
-                            // push keypoints and descriptor for current frame to end of data buffer
-                            (dataBuffer.end() - 1)->keypoints = keypoints;
+            // continue the tracks of the matched bounding boxes
+            trackManager.update(&*(dataBuffer.end() - 2), *(dataBuffer.end() - 1));
 
-                            cout << "#5 : DETECT KEYPOINTS done" << endl;
+            // where the keypoints are expected in the next frame, for the guided matching
+            if (settings.bGuidedMatching and not settings.bKltTracking) {
+                predictKeypointPositions(*(dataBuffer.end() - 2), *(dataBuffer.end() - 1), kGuidedMinMotionSupport,
+                                         (dataBuffer.end() - 1)->predictedKeypoints);
+            }
 
+            stageTimer.lap(stage_TRACK_OBJECTS);
 
-                            /* EXTRACT KEYPOINT DESCRIPTORS */
 
-                            cv::Mat descriptors;
-                            string descriptor = ToString(e_descriptor); // BRISK, BRIEF, ORB, FREAK, AKAZE, SIFT
-                            descKeypoints((dataBuffer.end() - 1)->keypoints, (dataBuffer.end() - 1)->cameraImg,
-                                          descriptors,
-                                          descriptor);
+            /* COMPUTE TTC ON OBJECT IN FRONT */
 
-                            // push descriptors for current frame to end of data buffer
-                            (dataBuffer.end() - 1)->descriptors = descriptors;
+            // when the frame deadline is at risk, only the object ahead in the ego lane is measured:
+            // the track whose box holds the most Lidar points, as the crop keeps the ego lane only
+            int egoTrackID = -1;
+            if (scheduler.degraded(degradation_EGO_LANE_TTC)) {
+                size_t maxLidarPointsInBox = 0;
+                for (const int trackID : trackManager.matchedTracks()) {
+                    const BoundingBox *currBB = trackManager.currBox(trackID, *(dataBuffer.end() - 1));
+                    if (currBB->lidarPointIndices.size() > maxLidarPointsInBox) {
+                        maxLidarPointsInBox = currBB->lidarPointIndices.size();
+                        egoTrackID = trackID;
+                    }
+                }
+            }
 
-                            cout << "#6 : EXTRACT DESCRIPTORS done" << endl;
+            // loop over all tracks having bounding boxes in both frames
+            for (const int trackID : trackManager.matchedTracks()) {
+                if (egoTrackID != -1 and trackID != egoTrackID) {
+                    continue;
+                }
 
+                BoundingBox *prevBB = trackManager.prevBox(trackID, *(dataBuffer.end() - 2));
+                BoundingBox *currBB = trackManager.currBox(trackID, *(dataBuffer.end() - 1));
 
-                            if (dataBuffer.size() > 1) // wait until at least two images have been processed
-                            {
+                // compute time-to-collision based on Lidar data, if both boxes have enough Lidar points
+                double ttcLidar = NAN, rangeCurr = NAN, rangeVariance = NAN;
+                const bool bLidarValid = std::isfinite(currBB->lidarRange.range) and
+                                         std::isfinite(prevBB->lidarRange.range);
+                if (bLidarValid) {
+                    computeTTCLidar(prevBB->lidarRange, currBB->lidarRange, sensorFrameRate,
+                                    ttcLidar, rangeCurr, rangeVariance);
+                }
 
-                                /* MATCH KEYPOINT DESCRIPTORS */
-
-                                vector<cv::DMatch> matches;
-                                string matcherType = ToString(e_matcher);        // BF, FLANN
-                                string descriptorType = ToString(e_descriptor_type); // BINARY, HOG
-                                string selectorType = ToString(e_selector);       // NN, KNN
-
-                                matchDescriptors((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
-                                                 (dataBuffer.end() - 2)->descriptors,
-                                                 (dataBuffer.end() - 1)->descriptors,
-                                                 matches, descriptorType, matcherType, selectorType);
-
-                                // store matches in current data frame
-                                (dataBuffer.end() - 1)->kptMatches = matches;
-
-                                cout << "#7 : MATCH KEYPOINT DESCRIPTORS done" << endl;
-
-
-                                /* TRACK 3D OBJECT BOUNDING BOXES */
-
-                                // associate bounding boxes between current and previous frame using keypoint matches
-                                map<int, int> bbBestMatches;
-                                matchBoundingBoxes(matches, bbBestMatches, *(dataBuffer.end() - 2),
-                                                   *(dataBuffer.end() - 1));
-
-                                // store matches in current data frame
-                                (dataBuffer.end() - 1)->bbMatches = bbBestMatches;
-
-                                cout << "#8 : TRACK 3D OBJECT BOUNDING BOXES done" << endl;
-
-
-                                /* COMPUTE TTC ON OBJECT IN FRONT */
-
-                                // loop over all BB match pairs
-                                for (auto it1 = (dataBuffer.end() - 1)->bbMatches.begin();
-                                     it1 != (dataBuffer.end() - 1)->bbMatches.end(); ++it1) {
-                                    // find bounding boxes associates with current match
-                                    BoundingBox *prevBB, *currBB;
-                                    for (auto it2 = (dataBuffer.end() - 1)->boundingBoxes.begin();
-                                         it2 != (dataBuffer.end() - 1)->boundingBoxes.end(); ++it2) {
-                                        if (it1->second ==
-                                            it2->boxID) // check wether current match partner corresponds to this BB
-                                        {
-                                            currBB = &(*it2);
-                                        }
-                                    }
-
-                                    for (auto it2 = (dataBuffer.end() - 2)->boundingBoxes.begin();
-                                         it2 != (dataBuffer.end() - 2)->boundingBoxes.end(); ++it2) {
-                                        if (it1->first ==
-                                            it2->boxID) // check wether current match partner corresponds to this BB
-                                        {
-                                            prevBB = &(*it2);
-                                        }
-                                    }
-
-                                    // compute TTC for current match
-                                    if (currBB->lidarPoints.size() > 0 &&
-                                        prevBB->lidarPoints.size() > 0) // only compute TTC if we have Lidar points
-                                    {
-                                        // compute time-to-collision based on Lidar data
-                                        double ttcLidar;
-                                        computeTTCLidar(prevBB->lidarPoints, currBB->lidarPoints, sensorFrameRate,
-                                                        ttcLidar);
-
-                                        // compute time-to-collision based on camera
-                                        double ttcCamera;
-                                        // assign enclosed keypoint matches to bounding box
-                                        clusterKptMatchesWithROI(*currBB, (dataBuffer.end() - 2)->keypoints,
-                                                                 (dataBuffer.end() - 1)->keypoints,
-                                                                 (dataBuffer.end() - 1)->kptMatches);
-                                        computeTTCCamera((dataBuffer.end() - 2)->keypoints,
-                                                         (dataBuffer.end() - 1)->keypoints, currBB->kptMatches,
-                                                         sensorFrameRate, ttcCamera);
-
-                                        const bool is_valid = not
-                                                ( std::isnan(ttcLidar)  or
-                                                  std::isnan(ttcCamera) or
-                                                  std::isinf(ttcLidar)  or
-                                                  std::isinf(ttcCamera) );
-
-
-                                        if (is_valid) {
-                                            bVis = kSingleRunFlag;
-                                            if (bVis) {
-                                                cv::Mat visImg = (dataBuffer.end() - 1)->cameraImg.clone();
-                                                showLidarImgOverlay(visImg, currBB->lidarPoints, P_rect_00, R_rect_00,
-                                                                    RT,
-                                                                    &visImg);
-                                                cv::rectangle(visImg, cv::Point(currBB->roi.x, currBB->roi.y),
-                                                              cv::Point(currBB->roi.x + currBB->roi.width,
-                                                                        currBB->roi.y + currBB->roi.height),
-                                                              cv::Scalar(0, 255, 0), 2);
-
-                                                char str[200];
-                                                sprintf(str, "Image ID: %d, TTC Lidar : %f s, TTC Camera : %f s",
-                                                        imgIndex, ttcLidar, ttcCamera);
-                                                putText(visImg, str, cv::Point2f(80, 50), cv::FONT_HERSHEY_PLAIN, 2,
-                                                        cv::Scalar(0, 0, 255));
-
-                                                string windowName = "Final Results : TTC";
-                                                cv::namedWindow(windowName, 4);
-                                                cv::imshow(windowName, visImg);
-                                                cout << "Press key to continue to next frame" << endl;
-                                                cv::waitKey(0);
-                                            }
-                                            bVis = false;
-
-                                            ttc_ofs << imgIndex << ' ' << ttcLidar << ' ' << ttcCamera << '\n';
-                                        }
-
-                                    } // eof TTC computation
-                                } // eof loop over all BB matches
-
-                            } // end of "if" data buffer is not empty
-
-                        } // eof loop over all images
-
-                        if (kSingleRunFlag)
-                        {
-                            goto out;
+                // compute time-to-collision based on camera
+                double ttcCamera, ttcCameraVariance;
+                // assign enclosed keypoint matches to bounding box
+                clusterKptMatchesWithROI(*currBB, (dataBuffer.end() - 2)->keypoints,
+                                         (dataBuffer.end() - 1)->keypoints,
+                                         (dataBuffer.end() - 1)->kptMatches);
+                computeTTCCamera((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
+                                 IndexedView<cv::DMatch>((dataBuffer.end() - 1)->kptMatches,
+                                                         currBB->kptMatchIndices),
+                                 sensorFrameRate, ttcCamera, ttcCameraVariance,
+                                 settings.maxMatchPairs);
+
+                // fuse both measurements over time in the track's filter; the filter
+                // smooths out the extra noise of the subsampled estimators and carries the track
+                // over the frames on which one of the sensors has no measurement
+                double ttcFused = NAN;
+                if (settings.bFusion) {
+                    Track& track = trackManager.track(trackID);
+                    TtcFilter& ttcFilter = track.ttcFilter;
+                    if (not ttcFilter.initialized()) {
+                        if (bLidarValid) {
+                            ttcFilter.init(rangeCurr, rangeVariance, ttcLidar);
+                            track.filterFrameIndex = imgIndex;
+                        }
+                    } else {
+                        // the track may have been skipped on some frames, e.g., in the ego-lane-only mode
+                        ttcFilter.predict((imgIndex - track.filterFrameIndex) /
+                                          (sensorFrameRate * settings.imgStepWidth));
+                        track.filterFrameIndex = imgIndex;
+                        if (bLidarValid) {
+                            ttcFilter.correctRange(rangeCurr, rangeVariance);
                         }
+                    }
+                    if (ttcFilter.initialized()) {
+                        if (std::isfinite(ttcCamera) and std::isfinite(ttcCameraVariance) and
+                            ttcCamera != 0.0 and ttcCameraVariance > 0.0) {
+                            ttcFilter.correctTTC(ttcCamera, ttcCameraVariance);
+                        }
+                        ttcFused = ttcFilter.ttc();
+                    }
+                }
 
+                ResultRecord record;
+                record.frame_index = imgIndex;
+                record.track_id = trackID;
+                record.detector = config.detector;
+                record.descriptor = config.descriptor;
+                record.descriptor_type = config.descriptor_type;
+                record.matcher = config.matcher;
+                record.selector = config.selector;
+                record.ttc_lidar = ttcLidar;
+                record.ttc_camera = ttcCamera;
+                record.ttc_fused = ttcFused;
+                record.frame_keypoints = static_cast<int32_t>((dataBuffer.end() - 1)->keypoints.size());
+                record.frame_matches = static_cast<int32_t>((dataBuffer.end() - 1)->kptMatches.size());
+                record.box_matches = static_cast<int32_t>(currBB->kptMatchIndices.size());
+                record.box_lidar_points = static_cast<int32_t>(currBB->lidarPointIndices.size());
+                frameResults.push_back(record);
+                if (sweepScore) {
+                    sweepScore->addMeasurement(ttcLidar, ttcCamera);
+                }
+
+                const bool is_valid = not
+                        ( std::isnan(ttcLidar)  or
+                          std::isnan(ttcCamera) or
+                          std::isinf(ttcLidar)  or
+                          std::isinf(ttcCamera) );
+
+
+                if (is_valid) {
+                    bVis = settings.bSingleRun;
+                    if (bVis) {
+                        cv::Mat visImg = (dataBuffer.end() - 1)->cameraImg.clone();
+                        showLidarImgOverlay(visImg, (dataBuffer.end() - 1)->lidarPoints,
+                                            currBB->lidarPointIndices,
+                                            (dataBuffer.end() - 1)->lidarDepth, &visImg);
+                        cv::rectangle(visImg, cv::Point(currBB->roi.x, currBB->roi.y),
+                                      cv::Point(currBB->roi.x + currBB->roi.width,
+                                                currBB->roi.y + currBB->roi.height),
+                                      cv::Scalar(0, 255, 0), 2);
+
+                        char str[200];
+                        sprintf(str, "Image ID: %d, TTC Lidar : %f s, TTC Camera : %f s",
+                                imgIndex, ttcLidar, ttcCamera);
+                        putText(visImg, str, cv::Point2f(80, 50), cv::FONT_HERSHEY_PLAIN, 2,
+                                cv::Scalar(0, 0, 255));
+
+                        string windowName = "Final Results : TTC";
+                        cv::namedWindow(windowName, 4);
+                        cv::imshow(windowName, visImg);
+                        cout << "Press key to continue to next frame" << endl;
+                        cv::waitKey(0);
                     }
+                    bVis = false;
+
+                    trackManager.record(trackID, imgIndex, ttcLidar, ttcCamera);
+
+                    ttc_ofs << imgIndex << ' ' << ttcLidar << ' ' << ttcCamera;
+                    if (settings.bFusion) {
+                        ttc_ofs << ' ' << ttcFused;
+                    }
+                    ttc_ofs << '\n';
                 }
+            } // eof loop over all tracks
+
+            stageTimer.lap(stage_COMPUTE_TTC);
+
+        } // end of "if" data buffer is not empty
+
+        // the latencies are known only once the whole frame has been processed
+        const Degradation frameDegradation = scheduler.level();
+        const bool bDeadlineMissed = scheduler.frameDone(stageTimer);
+        for (auto& record : frameResults)
+        {
+            for (size_t stage = 0; stage < num_of_stages; ++stage)
+            {
+                record.latency_ms[stage] = stageTimer.ms(static_cast<Stage>(stage));
             }
+            record.degradation_level = frameDegradation;
+            record.deadline_miss = bDeadlineMissed;
+            resultsSink.add(record);
         }
+        frameResults.clear();
+        if (sweepScore)
+        {
+            double processingMs = 0.0;
+            for (size_t stage = stage_LOAD + 1; stage < num_of_stages; ++stage)
+            {
+                processingMs += stageTimer.ms(static_cast<Stage>(stage));
+            }
+            sweepScore->addFrame(processingMs);
+        }
+
+    } // eof loop over all images
+
+    resultsSink.flush();
+    if (settings.frameBudgetMs > 0.0)
+    {
+        cout << sequence.name << ": deadline misses: " << scheduler.deadlineMisses() << " of " << scheduler.frames()
+             << " frames, final quality level: " << degradation_names[scheduler.level()] << endl;
+    }
+    ExportResultsCsv(sequence.resultsPrefix + ".results", sequence.resultsPrefix + ".csv");
+}
+
+// successive-halving sweep: every round runs the remaining combinations on a prefix of the sequence, and only the
+// survivors (see SelectHalvingSurvivors) are run in the next round, on a prefix longer by the inverse of the kept
+// fraction; the last round runs the whole sequence, and its survivors are the result; the scores of all the rounds
+// are written to halving_summary.txt
+static void runHalvingSweep(const RunSettings& settings, const SequenceRun& baseSequence,
+                            vector<PipelineConfig> candidates, ResourcePool<DetectorNets>& netPool,
+                            const int firstRoundFrames, const double keepFraction, const double latencyWeight)
+{
+    std::ofstream summary{"halving_summary.txt"};
+    summary << "round frames combination disagreement ms_per_frame score promoted\n";
+
+    const int totalFrames = (baseSequence.imgEndIndex - settings.imgStartIndex) / settings.imgStepWidth + 1;
+    double frames = firstRoundFrames;
+    for (int round = 0; ; ++round)
+    {
+        // a single remaining combination needs no more pruning
+        const int roundFrames = candidates.size() <= 1 ? totalFrames
+                                                       : std::min(totalFrames, static_cast<int>(std::ceil(frames)));
+        const bool bLastRound = roundFrames == totalFrames;
+
+        vector<SweepScore> scores(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            SequenceRun sequence = baseSequence;
+            sequence.imgEndIndex = settings.imgStartIndex + (roundFrames - 1) * settings.imgStepWidth;
+            sequence.name = "halving_round" + std::to_string(round) + "_" + ToString(candidates[i]);
+            sequence.resultsPrefix = sequence.name;
+            sequence.ttcPath = sequence.name + ".txt";
+
+            const auto keypointPipeline = MakeKeypointPipeline(candidates[i]);
+            runSequence(settings, sequence, candidates[i], netPool, *keypointPipeline, &scores[i]);
+        }
+
+        const vector<size_t> survivors = SelectHalvingSurvivors(scores, keepFraction, latencyWeight);
+        vector<bool> promoted(candidates.size(), false);
+        for (const size_t i : survivors)
+        {
+            promoted[i] = true;
+        }
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            summary << round << ' ' << roundFrames << ' ' << ToString(candidates[i]) << ' '
+                    << scores[i].disagreement() << ' ' << scores[i].msPerFrame() << ' '
+                    << scores[i].score(latencyWeight) << ' ' << promoted[i] << '\n';
+        }
+        cout << "halving round " << round << ": " << candidates.size() << " combinations on " << roundFrames
+             << " frames, " << survivors.size() << (bLastRound ? " selected" : " promoted") << endl;
+
+        vector<PipelineConfig> next;
+        for (const size_t i : survivors)
+        {
+            next.push_back(candidates[i]);
+            if (bLastRound)
+            {
+                cout << "  " << ToString(candidates[i]) << ": TTC disagreement " << scores[i].disagreement()
+                     << ", " << scores[i].msPerFrame() << " ms per frame" << endl;
+            }
+        }
+        if (bLastRound)
+        {
+            break;
+        }
+        candidates.swap(next);
+        // the prefix grows by at least a frame, so that the whole sequence is reached despite the rounding
+        frames = std::max(roundFrames + 1.0, roundFrames / keepFraction);
+    }
+}
+
+// processes the drives concurrently with the single-run combination; every worker checks its keypoint pipeline
+// out of a pool and shares the networks; returns the number of the drives which have failed
+static size_t runSequences(const RunSettings& settings, const PipelineConfig& config, const vector<string>& roots,
+                           const ThreadBudget& threadBudget, ResourcePool<DetectorNets>& netPool)
+{
+    const size_t workers = threadBudget.workers();
+    ResourcePool<KeypointPipeline> pipelinePool([&config] { return MakeKeypointPipeline(config); }, workers);
+
+    std::atomic<size_t> nextRoot{0};
+    std::atomic<size_t> failures{0};
+    std::mutex outputMutex;
+    vector<std::thread> threads;
+    for (size_t worker = 0; worker < workers; ++worker)
+    {
+        threads.emplace_back([&, worker]() {
+            for (size_t i = nextRoot++; i < roots.size(); i = nextRoot++)
+            {
+                string root = roots[i];
+                while (root.size() > 1 and root.back() == '/')
+                {
+                    root.pop_back();
+                }
+
+                SequenceRun sequence;
+                sequence.name = root.substr(root.find_last_of('/') + 1);
+                sequence.imgPrefix = root + "/image_02/data/";
+                sequence.lidarPrefix = root + "/velodyne_points/data/";
+                sequence.imgFillWidth = 10;
+                sequence.resultsPrefix = sequence.name + "_" + ToString(config);
+                sequence.ttcPath = sequence.resultsPrefix + ".txt";
+
+                // a drive is processed unpinned rather than not at all if the cores cannot be reserved for it
+                string pinWarning;
+                try
+                {
+                    threadBudget.enterWorker(worker);
+                }
+                catch (const std::runtime_error& e)
+                {
+                    pinWarning = string(" (warning: ") + e.what() + ", not pinned)";
+                }
+
+                string status;
+                try
+                {
+                    sequence.imgEndIndex = findLastFrameNumber(sequence.imgPrefix, settings.imgFileType,
+                                                               settings.imgStartIndex, sequence.imgFillWidth);
+                    if (sequence.imgEndIndex < settings.imgStartIndex)
+                    {
+                        throw std::runtime_error("no frames in " + sequence.imgPrefix);
+                    }
+
+                    const auto keypointPipeline = pipelinePool.checkout();
+                    runSequence(settings, sequence, config, netPool, *keypointPipeline);
+                    status = "done, " + std::to_string(sequence.imgEndIndex - settings.imgStartIndex + 1) +
+                             " frames";
+                }
+                catch (const std::exception& e)
+                {
+                    ++failures;
+                    status = string("failed: ") + e.what();
+                }
+                std::lock_guard<std::mutex> lock(outputMutex);
+                cout << sequence.name << ": " << status << pinWarning << endl;
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return failures;
+}
+
+
+/* MAIN PROGRAM */
+int main(int argc, const char* argv[])
+{
+    /* INIT VARIABLES AND DATA STRUCTURES */
+
+    // command line options:
+    //   --yolo=full|tiny   YOLO model to detect objects with (default: full)
+    //   --yolo-size=N      network input resolution NxN, N must be a multiple of 32 (default: 416)
+    //   --cascade=N        run tiny YOLO on every frame and the full model every N frames or whenever
+    //                      the tiny model disagrees with the tracked boxes; 0 disables the cascade (default: 0)
+    //   --detect-every=K   run the object detector only every K frames and propagate the boxes of the previous
+    //                      frame with the keypoint matches in between (default: 1)
+    //   --detect-batch=N   read the frames ahead in chunks of N and detect the objects of a chunk in a single forward
+    //                      pass (offline); cannot be combined with --cascade, --detect-every, --frame-budget-ms
+    //                      and a streamed --source (default: 1, detect frame by frame)
+    //   --fusion=0|1       fuse the Lidar and Camera measurements of every track with a Kalman filter and
+    //                      report the fused TTC as an additional column (default: 0)
+    //   --max-lidar-points=N   estimate the Lidar TTC from at most N points per box, 0 means all (default: 0)
+    //   --max-match-pairs=N    estimate the Camera TTC from at most N random keypoint match pairs,
+    //                          0 means all (default: 0)
+    //   --ground=0|1       remove the ground points with a RANSAC plane fit instead of the fixed lower crop
+    //                      bound (default: 0)
+    //   --voxel-size=S     keep only the closest point of every SxSxS m voxel, 0 disables it (default: 0)
+    //   --source=files|fifo:PATH|unix:PATH  read the frames from the numbered files of the bundled sequence, or
+    //                      receive them from a named pipe or a Unix domain socket the tracker listens on,
+    //                      e.g., published by frame_replayer (default: files)
+    //   --stream-buffer=N  no. of received frames buffered ahead of the processing (default: 4)
+    //   --sweep-dir=DIR    run the whole configuration sweep sharded over worker processes, which share the
+    //                      combinations through claim files in DIR; an interrupted sweep resumes with the same DIR,
+    //                      and several hosts may share DIR on a shared file system
+    //   --sweep-workers=N  no. of worker processes of the sharded sweep (default: no. of hardware threads)
+    //   --lidar-cluster-tol=T  keep only the largest Euclidean cluster (tolerance T m) of the Lidar points
+    //                          of every box, 0 disables it (default: 0)
+    //   --frame-budget-ms=B    degrade the quality step by step whenever the processing of the frames approaches
+    //                          B ms, and restore it once there is headroom again; 0 disables it (default: 0)
+    //   --sequences=DIR[,DIR...]  process the given KITTI drives (directories with image_02/data and
+    //                      velodyne_points/data) concurrently instead of the bundled sequence; the results of every
+    //                      drive are written with the drive's directory name as the prefix
+    //   --sequence-workers=N   no. of drives processed at the same time (default: no. of hardware threads)
+    //   --net-pool=K       no. of instances of the networks shared by the drives processed at the same time
+    //                      (default: 2)
+    //   --tracking=descriptors|klt  find the keypoint correspondences by matching the descriptors of the detected
+    //                      keypoints, or by tracking the previous frame's keypoints with the pyramidal Lucas-Kanade
+    //                      optical flow, re-detecting them only once too few are tracked (default: descriptors)
+    //   --matching=global|guided  compare every descriptor with all descriptors of the next frame, or only with
+    //                      those whose keypoints lie around the position predicted from the motion of the tracked
+    //                      box or the background the keypoint belongs to (default: global)
+    //   --pin-threads=0|1  pin every worker (the single run, a sweep worker process or a drive's thread) to its
+    //                      share of the cores (default: 0)
+    //   --config=NAME      combination of the single run, named as in the result files, e.g., FAST_BRIEF_BINARY_BF_KNN
+    //                      (default: SHITOMASI_ORB_BINARY_BF_NN)
+    //   --visualize=0|1    show the windows of the single run, waiting for a key press on every frame (default: 1)
+    //   --data=DIR         directory with the images/ and dat/ subdirectories (default: ../)
+    //   --halving-sweep=0|1    run all the combinations on the first frames, keep only the best fraction of them
+    //                      and those on the Pareto front of the TTC disagreement and latency, and repeat on
+    //                      longer prefixes until the whole sequence is reached (default: 0)
+    //   --halving-frames=N     no. of frames of the first round, at least 2 (default: 4)
+    //   --halving-keep=F   fraction of the combinations promoted to the next round, whose prefix is longer by
+    //                      a factor of 1/F, in (0, 1) (default: 0.5)
+    //   --halving-latency-weight=W  the combinations are ranked by the mean relative deviation of their Camera
+    //                      TTC from the Lidar TTC plus W per 100 ms of processing per frame (default: 0.2)
+    const auto options = ParseOptions(argc, argv, {
+            "yolo", "yolo-size", "cascade", "detect-every", "detect-batch", "fusion", "max-lidar-points",
+            "max-match-pairs", "ground", "voxel-size", "source", "stream-buffer", "sweep-dir", "sweep-workers",
+            "lidar-cluster-tol", "frame-budget-ms", "sequences", "sequence-workers", "net-pool", "tracking",
+            "matching", "pin-threads", "config", "visualize", "data", "halving-sweep", "halving-frames",
+            "halving-keep", "halving-latency-weight"});
+    RunSettings settings;
+
+    // data location
+    string dataPath = GetOption(options, "data", "../");
+    if (not dataPath.empty() and dataPath.back() != '/')
+    {
+        dataPath += '/';
+    }
+
+    // camera
+    string imgBasePath = dataPath + "images/";
+    string imgPrefix = "KITTI/2011_09_26/image_02/data/000000"; // left camera, color
+    settings.imgFileType = ".png";
+    settings.imgStartIndex = 0; // first file index to load (assumes Lidar and camera names have identical naming convention)
+    int imgEndIndex = 18;   // last file index to load
+    settings.imgStepWidth = 1;
+    int imgFillWidth = 4;  // no. of digits which make up the file index (e.g. img-0001.png)
+
+    // object detection
+    string yoloBasePath = dataPath + "dat/yolo/";
+    string yoloClassesFile = yoloBasePath + "coco.names";
+    const int yoloInputSize = std::stoi(GetOption(options, "yolo-size", "416"));
+    if (yoloInputSize <= 0 or yoloInputSize % 32 != 0)
+    {
+        throw std::invalid_argument("YOLO input size must be a positive multiple of 32");
+    }
+    settings.yoloInputSize = cv::Size(yoloInputSize, yoloInputSize);
+    const YoloModel yoloFull{yoloBasePath + "yolov3.cfg", yoloBasePath + "yolov3.weights", settings.yoloInputSize};
+    const YoloModel yoloTiny{yoloBasePath + "yolov3-tiny.cfg", yoloBasePath + "yolov3-tiny.weights",
+                             settings.yoloInputSize};
+    const string yoloModelName = GetOption(options, "yolo", "full");
+    if (yoloModelName != "full" and yoloModelName != "tiny")
+    {
+        throw std::invalid_argument("unknown YOLO model: " + yoloModelName);
+    }
+    settings.cascadePeriod = std::stoi(GetOption(options, "cascade", "0"));
+    settings.bCascade = settings.cascadePeriod > 0;
+    settings.detectionPeriod = std::stoi(GetOption(options, "detect-every", "1"));
+    settings.detectionBatchSize = std::stoul(GetOption(options, "detect-batch", "1"));
+    settings.bFusion = std::stoi(GetOption(options, "fusion", "0")) != 0;
+    settings.maxLidarPoints = std::stoul(GetOption(options, "max-lidar-points", "0"));
+    settings.maxMatchPairs = std::stoul(GetOption(options, "max-match-pairs", "0"));
+    settings.bGroundRemoval = std::stoi(GetOption(options, "ground", "0")) != 0;
+    settings.voxelSize = std::stof(GetOption(options, "voxel-size", "0"));
+    settings.frameSourceName = GetOption(options, "source", "files");
+    settings.streamBufferFrames = std::stoul(GetOption(options, "stream-buffer", "4"));
+    settings.lidarClusterTolerance = std::stof(GetOption(options, "lidar-cluster-tol", "0"));
+    settings.frameBudgetMs = std::stod(GetOption(options, "frame-budget-ms", "0"));
+    const string trackingMode = GetOption(options, "tracking", "descriptors");
+    if (trackingMode != "descriptors" and trackingMode != "klt")
+    {
+        throw std::invalid_argument("unknown tracking mode: " + trackingMode);
+    }
+    settings.bKltTracking = trackingMode == "klt";
+    const string matchingMode = GetOption(options, "matching", "global");
+    if (matchingMode != "global" and matchingMode != "guided")
+    {
+        throw std::invalid_argument("unknown matching mode: " + matchingMode);
+    }
+    settings.bGuidedMatching = matchingMode == "guided";
+    const string sweepDir = GetOption(options, "sweep-dir", "");
+    const size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t sweepWorkers = std::stoul(GetOption(options, "sweep-workers", std::to_string(hardwareThreads)));
+    const vector<string> sequenceRoots = SplitOptionList(GetOption(options, "sequences", ""));
+    const size_t sequenceWorkers = std::stoul(GetOption(options, "sequence-workers",
+                                                        std::to_string(hardwareThreads)));
+    const size_t netPoolSize = std::stoul(GetOption(options, "net-pool", "2"));
+    const bool bPinThreads = std::stoi(GetOption(options, "pin-threads", "0")) != 0;
+    const bool bHalvingSweep = std::stoi(GetOption(options, "halving-sweep", "0")) != 0;
+    const int halvingFrames = std::stoi(GetOption(options, "halving-frames", "4"));
+    const double halvingKeep = std::stod(GetOption(options, "halving-keep", "0.5"));
+    const double halvingLatencyWeight = std::stod(GetOption(options, "halving-latency-weight", "0.2"));
+    if (bHalvingSweep and (not sweepDir.empty() or not sequenceRoots.empty()))
+    {
+        throw std::invalid_argument("--halving-sweep runs in a single process on the bundled sequence");
     }
-out:
+    if (halvingFrames < 2 or halvingKeep <= 0.0 or halvingKeep >= 1.0)
+    {
+        throw std::invalid_argument("--halving-frames must be at least 2 and --halving-keep in (0, 1)");
+    }
+    if (settings.detectionBatchSize == 0)
+    {
+        throw std::invalid_argument("--detect-batch must be positive");
+    }
+    if (settings.detectionBatchSize > 1 and
+        (settings.bCascade or settings.detectionPeriod > 1 or settings.frameBudgetMs > 0.0 or
+         settings.frameSourceName != "files"))
+    {
+        throw std::invalid_argument("--detect-batch cannot be combined with --cascade, --detect-every, "
+                                    "--frame-budget-ms or a streamed --source");
+    }
+    settings.confThreshold = 0.2;
+    settings.nmsThreshold = 0.4;
+    if (not sequenceRoots.empty() and (not sweepDir.empty() or settings.frameSourceName != "files"))
+    {
+        throw std::invalid_argument("--sequences cannot be combined with --sweep-dir or a streamed --source");
+    }
+    if (sequenceWorkers == 0)
+    {
+        throw std::invalid_argument("--sequence-workers must be positive");
+    }
+
+    // a single combination with the visualization, or the whole sweep
+    const string singleRunName = GetOption(options, "config", ToString(kSingleRunConfig));
+    PipelineConfig singleRunConfig = kSingleRunConfig;
+    bool bKnownConfig = false;
+    for (const auto& config : EnumeratePipelineConfigs())
+    {
+        if (ToString(config) == singleRunName)
+        {
+            singleRunConfig = config;
+            bKnownConfig = true;
+        }
+    }
+    if (not bKnownConfig)
+    {
+        throw std::invalid_argument("unknown combination: " + singleRunName);
+    }
+    const bool bVisualize = std::stoi(GetOption(options, "visualize", "1")) != 0;
+    settings.bSingleRun = kSingleRunFlag and sweepDir.empty() and sequenceRoots.empty() and not bHalvingSweep and
+                          bVisualize;
+    const bool bSweep = not (kSingleRunFlag and sweepDir.empty());
+    const vector<PipelineConfig> configs = bSweep ? EnumeratePipelineConfigs()
+                                                  : vector<PipelineConfig>{singleRunConfig};
+
+    // the cores are shared by the workers running at the same time: the sweep processes, the threads of the drives,
+    // or the single sequence
+    const size_t concurrentWorkers = not sweepDir.empty() ? sweepWorkers
+                                     : not sequenceRoots.empty() ? std::min(sequenceWorkers, sequenceRoots.size())
+                                     : 1;
+    const ThreadBudget threadBudget{concurrentWorkers, bPinThreads};
+    cout << "thread budget: " << threadBudget.describe() << endl;
+
+    // in the sharded sweep mode, this process only coordinates the worker processes, which share the combinations
+    // through the queue in the sweep directory, and merges the results; the workers are forked before any network
+    // is loaded and before OpenCV starts its threads
+    std::unique_ptr<SweepQueue> sweepQueue;
+    size_t sweepWorker = 0;
+    if (not sweepDir.empty())
+    {
+        sweepQueue = std::make_unique<SweepQueue>(sweepDir);
+        const size_t released = sweepQueue->releaseStaleClaims();
+        if (released > 0)
+        {
+            cout << "resuming the sweep: " << released << " interrupted combination(s) will be run again" << endl;
+        }
+
+        if (not ForkSweepWorkers(sweepWorkers, &sweepWorker))
+        {
+            vector<string> names;
+            for (const auto& config : configs)
+            {
+                names.push_back(ToString(config));
+            }
+            const size_t incomplete = sweepQueue->merge(names);
+            cout << "sweep: " << names.size() - incomplete << " of " << names.size()
+                 << " combinations complete, results merged into " << sweepDir << "/sweep_results.txt" << endl;
+            return incomplete == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    // OpenCV starts its threads only now, in the worker processes of the sweep; the threads of the drives are pinned
+    // once they start
+    if (sequenceRoots.empty())
+    {
+        threadBudget.enterWorker(sweepWorker);
+    }
+    threadBudget.applyToProcess();
+
+    // every instance of the networks is loaded only once for the whole run; in the cascade mode the selected model
+    // is always the full one, and the tiny one serves as the fast path
+    const YoloModel& yoloModel = (yoloModelName == "tiny" and not settings.bCascade) ? yoloTiny : yoloFull;
+    ResourcePool<DetectorNets> netPool([&yoloModel, &yoloTiny, &settings]() {
+        auto nets = std::make_unique<DetectorNets>();
+        nets->yoloNet = loadYoloNet(yoloModel.configuration, yoloModel.weights);
+        if (settings.bCascade)
+        {
+            nets->yoloTinyNet = loadYoloNet(yoloTiny.configuration, yoloTiny.weights);
+        }
+        return nets;
+    }, sequenceRoots.empty() ? 1 : netPoolSize);
+    {
+        const auto nets = netPool.checkout(); // the first instance is loaded up front, outside the timed stages
+    }
+    settings.yoloClasses = loadClassNames(yoloClassesFile);
+
+    // Lidar
+    string lidarPrefix = "KITTI/2011_09_26/velodyne_points/data/000000";
+    settings.lidarFileType = ".bin";
+
+    // calibration data for camera and lidar
+    cv::Mat P_rect_00(3,4,cv::DataType<double>::type); // 3x4 projection matrix after rectification
+    cv::Mat R_rect_00(4,4,cv::DataType<double>::type); // 3x3 rectifying rotation to make image planes co-planar
+    cv::Mat RT(4,4,cv::DataType<double>::type); // rotation matrix and translation vector
+    
+    RT.at<double>(0,0) = 7.533745e-03; RT.at<double>(0,1) = -9.999714e-01; RT.at<double>(0,2) = -6.166020e-04; RT.at<double>(0,3) = -4.069766e-03;
+    RT.at<double>(1,0) = 1.480249e-02; RT.at<double>(1,1) = 7.280733e-04; RT.at<double>(1,2) = -9.998902e-01; RT.at<double>(1,3) = -7.631618e-02;
+    RT.at<double>(2,0) = 9.998621e-01; RT.at<double>(2,1) = 7.523790e-03; RT.at<double>(2,2) = 1.480755e-02; RT.at<double>(2,3) = -2.717806e-01;
+    RT.at<double>(3,0) = 0.0; RT.at<double>(3,1) = 0.0; RT.at<double>(3,2) = 0.0; RT.at<double>(3,3) = 1.0;
+    
+    R_rect_00.at<double>(0,0) = 9.999239e-01; R_rect_00.at<double>(0,1) = 9.837760e-03; R_rect_00.at<double>(0,2) = -7.445048e-03; R_rect_00.at<double>(0,3) = 0.0;
+    R_rect_00.at<double>(1,0) = -9.869795e-03; R_rect_00.at<double>(1,1) = 9.999421e-01; R_rect_00.at<double>(1,2) = -4.278459e-03; R_rect_00.at<double>(1,3) = 0.0;
+    R_rect_00.at<double>(2,0) = 7.402527e-03; R_rect_00.at<double>(2,1) = 4.351614e-03; R_rect_00.at<double>(2,2) = 9.999631e-01; R_rect_00.at<double>(2,3) = 0.0;
+    R_rect_00.at<double>(3,0) = 0; R_rect_00.at<double>(3,1) = 0; R_rect_00.at<double>(3,2) = 0; R_rect_00.at<double>(3,3) = 1;
+    
+    P_rect_00.at<double>(0,0) = 7.215377e+02; P_rect_00.at<double>(0,1) = 0.000000e+00; P_rect_00.at<double>(0,2) = 6.095593e+02; P_rect_00.at<double>(0,3) = 0.000000e+00;
+    P_rect_00.at<double>(1,0) = 0.000000e+00; P_rect_00.at<double>(1,1) = 7.215377e+02; P_rect_00.at<double>(1,2) = 1.728540e+02; P_rect_00.at<double>(1,3) = 0.000000e+00;
+    P_rect_00.at<double>(2,0) = 0.000000e+00; P_rect_00.at<double>(2,1) = 0.000000e+00; P_rect_00.at<double>(2,2) = 1.000000e+00; P_rect_00.at<double>(2,3) = 0.000000e+00;
+
+    settings.P_rect_00 = P_rect_00;
+    settings.R_rect_00 = R_rect_00;
+    settings.RT = RT;
+
+    if (bHalvingSweep)
+    {
+        SequenceRun sequence;
+        sequence.imgPrefix = imgBasePath + imgPrefix;
+        sequence.lidarPrefix = imgBasePath + lidarPrefix;
+        sequence.imgEndIndex = imgEndIndex;
+        sequence.imgFillWidth = imgFillWidth;
+        runHalvingSweep(settings, sequence, EnumeratePipelineConfigs(), netPool, halvingFrames, halvingKeep,
+                        halvingLatencyWeight);
+        return EXIT_SUCCESS;
+    }
+
+    if (not sequenceRoots.empty())
+    {
+        const size_t failures = runSequences(settings, singleRunConfig, sequenceRoots, threadBudget, netPool);
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    for (const auto& config : configs) {
+
+        std::string unique_prefix = ToString(config);
+        if (sweepQueue and not sweepQueue->claim(unique_prefix))
+        {
+            continue; // done or being run by another worker
+        }
+
+        std::cout << "\n\n\n\n" << unique_prefix << std::endl;
+
+        SequenceRun sequence;
+        sequence.name = unique_prefix;
+        sequence.imgPrefix = imgBasePath + imgPrefix;
+        sequence.lidarPrefix = imgBasePath + lidarPrefix;
+        sequence.imgEndIndex = imgEndIndex;
+        sequence.imgFillWidth = imgFillWidth;
+        sequence.ttcPath = sweepQueue ? sweepQueue->partialResultPath(unique_prefix) : unique_prefix + ".txt";
+        sequence.resultsPrefix = (sweepQueue ? sweepDir + "/" : "") + unique_prefix;
+
+        // keypoint detection, description and matching specialized for the combination
+        const auto keypointPipeline = MakeKeypointPipeline(config);
+        runSequence(settings, sequence, config, netPool, *keypointPipeline);
+
+        if (sweepQueue)
+        {
+            sweepQueue->complete(unique_prefix);
+        }
+    }
+
     return EXIT_SUCCESS;
 }
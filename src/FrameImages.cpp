@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <utility>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "FrameImages.hpp"
+
+
+FrameImages::FrameImages(cv::Mat color) : color_{std::move(color)}
+{
+
+}
+
+const cv::Mat& FrameImages::gray()
+{
+  if (gray_.empty() and not color_.empty())
+  {
+    if (color_.channels() == 1)
+    {
+      gray_ = color_;
+    }
+    else
+    {
+      cv::cvtColor(color_, gray_, cv::COLOR_BGR2GRAY);
+    }
+  }
+  return gray_;
+}
+
+const std::vector<cv::Mat>& FrameImages::flowPyramid(const cv::Size windowSize, const int maxLevel)
+{
+  if (flowPyramidMaxLevel_ != maxLevel or flowPyramidWindowSize_ != windowSize)
+  {
+    flowPyramid_.clear();
+    cv::buildOpticalFlowPyramid(gray(), flowPyramid_, windowSize, maxLevel);
+    flowPyramidWindowSize_ = windowSize;
+    flowPyramidMaxLevel_ = maxLevel;
+  }
+  return flowPyramid_;
+}
@@ -0,0 +1,57 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_FRAMEIMAGES_HPP
+#define CAMERA_FUSION_FRAMEIMAGES_HPP
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+
+// images derived from the camera image of a frame; each of them is computed on the first request and then shared
+// by all the stages (detection, description, optical flow) of this and the next frame
+class FrameImages
+{
+public:
+
+  FrameImages() = default;
+  explicit FrameImages(cv::Mat color);
+
+  const cv::Mat& color() const { return color_; }
+
+  const cv::Mat& gray();
+
+  // pyramid of the grayscale image for calcOpticalFlowPyrLK; rebuilt only if requested with other parameters
+  const std::vector<cv::Mat>& flowPyramid(cv::Size windowSize, int maxLevel);
+
+private:
+
+  cv::Mat color_;
+  cv::Mat gray_;
+  std::vector<cv::Mat> flowPyramid_;
+  cv::Size flowPyramidWindowSize_;
+  int flowPyramidMaxLevel_ = -1;
+};
+
+#endif //CAMERA_FUSION_FRAMEIMAGES_HPP
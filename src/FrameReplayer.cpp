@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// publishes the bundled KITTI sequence to a running 3D_object_tracking (started with --source=fifo:PATH or
+// --source=unix:PATH) at a fixed frame rate, imitating the live sensors; options:
+//   --target=fifo:PATH|unix:PATH   endpoint the tracker listens on (required)
+//   --rate=HZ                      frames per second (default: 10, the rate of the recording)
+//   --loop=0|1                     replay the sequence over and over instead of ending the stream (default: 0)
+//   --data=DIR                     directory with the images/ subdirectory (default: ../)
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "FrameSource.hpp"
+#include "Options.hpp"
+#include "lidarData.hpp"
+
+
+// opens the tracker's endpoint for writing; waits until the tracker is ready to receive
+static int connectToTracker(const std::string& target)
+{
+  if (target.compare(0, 5, "fifo:") == 0)
+  {
+    // blocks until the tracker opens the read end
+    const int fd = ::open(target.substr(5).c_str(), O_WRONLY);
+    if (fd < 0)
+    {
+      throw std::runtime_error("cannot open the named pipe " + target.substr(5) + ": " + std::strerror(errno));
+    }
+    return fd;
+  }
+
+  if (target.compare(0, 5, "unix:") == 0)
+  {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, target.substr(5).c_str(), sizeof(addr.sun_path) - 1);
+    while (true)
+    {
+      const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd < 0)
+      {
+        throw std::runtime_error(std::string("cannot create a socket: ") + std::strerror(errno));
+      }
+      if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0)
+      {
+        return fd;
+      }
+      ::close(fd);
+      std::this_thread::sleep_for(std::chrono::milliseconds(100)); // the tracker is not listening yet
+    }
+  }
+
+  throw std::invalid_argument("unknown target (expected fifo:PATH or unix:PATH): " + target);
+}
+
+int main(int argc, const char* argv[])
+{
+  const auto options = ParseOptions(argc, argv, {"target", "rate", "loop", "data"});
+  const std::string target = GetOption(options, "target", "");
+  const double rate = std::stod(GetOption(options, "rate", "10"));
+  const bool bLoop = std::stoi(GetOption(options, "loop", "0")) != 0;
+  const std::string dataPath = GetOption(options, "data", "../");
+  if (target.empty() or rate <= 0.0)
+  {
+    std::cerr << "usage: " << argv[0] << " --target=fifo:PATH|unix:PATH [--rate=HZ] [--loop=0|1] [--data=DIR]"
+              << std::endl;
+    return 1;
+  }
+
+  // the same sequence the tracker reads in its files mode
+  const int startIndex = 0;
+  const int endIndex = 18;
+  const FileFrameSource files(dataPath + "images/KITTI/2011_09_26/image_02/data/000000", ".png",
+                              dataPath + "images/KITTI/2011_09_26/velodyne_points/data/000000", ".bin",
+                              startIndex, endIndex, 1, 4);
+
+  // a disconnected tracker is reported by write() instead of killing the process
+  std::signal(SIGPIPE, SIG_IGN);
+  const int fd = connectToTracker(target);
+
+  const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / rate));
+  auto nextTick = std::chrono::steady_clock::now();
+  int frameIndex = 0;
+  do
+  {
+    for (int fileIndex = startIndex; fileIndex <= endIndex; ++fileIndex, ++frameIndex)
+    {
+      // the image is sent encoded as it is stored, the scan as it is loaded
+      std::ifstream imgFile(files.imageFilename(fileIndex), std::ios::binary);
+      const std::vector<uint8_t> encodedImage{std::istreambuf_iterator<char>(imgFile),
+                                              std::istreambuf_iterator<char>()};
+      std::vector<LidarPoint> lidarPoints;
+      loadLidarFromFile(lidarPoints, files.lidarFilename(fileIndex));
+
+      std::this_thread::sleep_until(nextTick);
+      nextTick += period;
+      writeStreamFrame(fd, frameIndex, encodedImage, lidarPoints);
+      std::cout << "published frame " << frameIndex << std::endl;
+    }
+  } while (bLoop);
+
+  // end-of-stream marker
+  writeStreamFrame(fd, -1, {}, {});
+  ::close(fd);
+
+  return 0;
+}
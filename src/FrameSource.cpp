@@ -0,0 +1,401 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "FrameSource.hpp"
+#include "lidarData.hpp"
+
+
+// upper bounds on the sizes announced by a frame header; anything larger is a corrupted or foreign stream
+constexpr uint32_t kMaxImageBytes = 64u << 20u;
+constexpr uint32_t kMaxLidarPointCount = 4u << 20u;
+
+// period in milliseconds at which the blocked receiver checks whether it has been asked to stop
+constexpr int kPollPeriodMs = 100;
+
+static std::runtime_error systemError(const std::string& what)
+{
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+
+FileFrameSource::FileFrameSource(std::string imgPrefix, std::string imgFileType, std::string lidarPrefix,
+                                 std::string lidarFileType, const int startIndex, const int endIndex,
+                                 const int stepWidth, const int fillWidth)
+  : imgPrefix_{std::move(imgPrefix)}, imgFileType_{std::move(imgFileType)},
+    lidarPrefix_{std::move(lidarPrefix)}, lidarFileType_{std::move(lidarFileType)},
+    startIndex_{startIndex}, endIndex_{endIndex}, stepWidth_{stepWidth}, fillWidth_{fillWidth}, nextIndex_{0}
+{
+  if (stepWidth <= 0)
+  {
+    throw std::invalid_argument("step width must be positive");
+  }
+}
+
+bool FileFrameSource::next(SensorFrame& frame)
+{
+  while (nextIndex_ <= endIndex_ - startIndex_)
+  {
+    const int frameNumber = startIndex_ + nextIndex_;
+    frame.index = nextIndex_;
+    nextIndex_ += stepWidth_;
+
+    // an unreadable image would make the detectors throw, so its frame is dropped
+    const std::string imgFilename = imageFilename(frameNumber);
+    frame.cameraImg = cv::imread(imgFilename);
+    if (frame.cameraImg.empty())
+    {
+      std::cerr << "cannot read the image " << imgFilename << ", dropping the frame" << std::endl;
+      continue;
+    }
+    frame.lidarPoints.clear();
+    loadLidarFromFile(frame.lidarPoints, lidarFilename(frameNumber));
+    return true;
+  }
+  return false;
+}
+
+static std::string numberedFilename(const std::string& prefix, const int number, const int fillWidth,
+                                    const std::string& fileType)
+{
+  std::ostringstream oss;
+  oss << prefix << std::setfill('0') << std::setw(fillWidth) << number << fileType;
+  return oss.str();
+}
+
+std::string FileFrameSource::imageFilename(const int frameNumber) const
+{
+  return numberedFilename(imgPrefix_, frameNumber, fillWidth_, imgFileType_);
+}
+
+std::string FileFrameSource::lidarFilename(const int frameNumber) const
+{
+  return numberedFilename(lidarPrefix_, frameNumber, fillWidth_, lidarFileType_);
+}
+
+int findLastFrameNumber(const std::string& imgPrefix, const std::string& imgFileType, const int startIndex,
+                        const int fillWidth)
+{
+  int frameNumber = startIndex;
+  while (std::ifstream(numberedFilename(imgPrefix, frameNumber, fillWidth, imgFileType)).good())
+  {
+    ++frameNumber;
+  }
+  return frameNumber - 1;
+}
+
+
+static void writeFully(const int fd, const void* data, size_t size)
+{
+  const auto* bytes = static_cast<const char*>(data);
+  while (size > 0)
+  {
+    const ssize_t n = ::write(fd, bytes, size);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      throw systemError("cannot write the frame stream");
+    }
+    bytes += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+void writeStreamFrame(const int fd, const int index, const std::vector<uint8_t>& encodedImage,
+                      const std::vector<LidarPoint>& lidarPoints)
+{
+  FrameHeader header;
+  header.index = index;
+  header.imageBytes = static_cast<uint32_t>(encodedImage.size());
+  header.lidarPointCount = static_cast<uint32_t>(lidarPoints.size());
+
+  std::vector<float> scan;
+  scan.reserve(4 * lidarPoints.size());
+  for (const auto& lpt : lidarPoints)
+  {
+    scan.insert(scan.end(), {static_cast<float>(lpt.x), static_cast<float>(lpt.y),
+                             static_cast<float>(lpt.z), static_cast<float>(lpt.r)});
+  }
+
+  writeFully(fd, &header, sizeof(header));
+  writeFully(fd, encodedImage.data(), encodedImage.size());
+  writeFully(fd, scan.data(), scan.size() * sizeof(float));
+}
+
+
+StreamFrameSource::StreamFrameSource(const std::string& endpoint, const size_t bufferCapacity)
+  : bufferCapacity_{bufferCapacity}
+{
+  if (bufferCapacity == 0)
+  {
+    throw std::invalid_argument("stream buffer capacity must be positive");
+  }
+
+  if (endpoint.compare(0, 5, "fifo:") == 0)
+  {
+    transport_ = Transport::kFifo;
+    path_ = endpoint.substr(5);
+    if (::mkfifo(path_.c_str(), 0666) != 0 and errno != EEXIST)
+    {
+      throw systemError("cannot create the named pipe " + path_);
+    }
+  }
+  else if (endpoint.compare(0, 5, "unix:") == 0)
+  {
+    transport_ = Transport::kUnixSocket;
+    path_ = endpoint.substr(5);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path))
+    {
+      throw std::invalid_argument("socket path is too long: " + path_);
+    }
+    std::strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd_ < 0)
+    {
+      throw systemError("cannot create a socket");
+    }
+    ::unlink(path_.c_str()); // a socket file left behind by a previous run
+    if (::bind(listenFd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 or
+        ::listen(listenFd_, 1) != 0)
+    {
+      const auto error = systemError("cannot listen on the socket " + path_);
+      ::close(listenFd_);
+      throw error;
+    }
+  }
+  else
+  {
+    throw std::invalid_argument("unknown stream endpoint (expected fifo:PATH or unix:PATH): " + endpoint);
+  }
+
+  receiver_ = std::thread(&StreamFrameSource::receive, this);
+}
+
+StreamFrameSource::~StreamFrameSource()
+{
+  stop_ = true;
+  bufferNotFull_.notify_all();
+  receiver_.join();
+
+  if (listenFd_ >= 0)
+  {
+    ::close(listenFd_);
+    ::unlink(path_.c_str());
+  }
+}
+
+bool StreamFrameSource::next(SensorFrame& frame)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  bufferNotEmpty_.wait(lock, [this] { return not buffer_.empty() or endOfStream_; });
+  if (buffer_.empty())
+  {
+    return false;
+  }
+
+  frame = std::move(buffer_.front());
+  buffer_.pop_front();
+  lock.unlock();
+  bufferNotFull_.notify_one();
+  return true;
+}
+
+void StreamFrameSource::receive()
+{
+  bool endMarker = false;
+  while (not stop_ and not endMarker)
+  {
+    const int fd = waitForSender();
+    if (fd < 0)
+    {
+      break;
+    }
+
+    FrameHeader header;
+    std::vector<uint8_t> encodedImage;
+    std::vector<float> scan;
+    while (readFully(fd, &header, sizeof(header)))
+    {
+      if (header.magic != FrameHeader::kMagic or header.imageBytes > kMaxImageBytes or
+          header.lidarPointCount > kMaxLidarPointCount)
+      {
+        std::cerr << "frame stream " << path_ << ": malformed frame header, dropping the sender" << std::endl;
+        break;
+      }
+      if (header.imageBytes == 0 and header.lidarPointCount == 0)
+      {
+        endMarker = true;
+        break;
+      }
+
+      encodedImage.resize(header.imageBytes);
+      scan.resize(4 * static_cast<size_t>(header.lidarPointCount));
+      if (not readFully(fd, encodedImage.data(), encodedImage.size()) or
+          not readFully(fd, scan.data(), scan.size() * sizeof(float)))
+      {
+        break;
+      }
+
+      SensorFrame frame;
+      frame.index = header.index;
+      frame.cameraImg = cv::imdecode(encodedImage, cv::IMREAD_COLOR);
+      if (frame.cameraImg.empty())
+      {
+        std::cerr << "frame stream " << path_ << ": cannot decode the image of frame " << header.index
+                  << ", dropping the frame" << std::endl;
+        continue;
+      }
+      frame.lidarPoints.resize(header.lidarPointCount);
+      for (size_t i = 0; i < frame.lidarPoints.size(); ++i)
+      {
+        frame.lidarPoints[i] = LidarPoint{scan[4 * i], scan[4 * i + 1], scan[4 * i + 2], scan[4 * i + 3]};
+      }
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      bufferNotFull_.wait(lock, [this] { return stop_ or buffer_.size() < bufferCapacity_; });
+      if (stop_)
+      {
+        break;
+      }
+      buffer_.push_back(std::move(frame));
+      lock.unlock();
+      bufferNotEmpty_.notify_one();
+    }
+
+    ::close(fd);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    endOfStream_ = true;
+  }
+  bufferNotEmpty_.notify_all();
+}
+
+int StreamFrameSource::waitForSender()
+{
+  if (transport_ == Transport::kFifo)
+  {
+    // a non-blocking open of the read end succeeds without a writer, and poll() reports no events on a pipe
+    // no writer has opened yet, so that the receiver keeps waiting in readFully()
+    const int fd = ::open(path_.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0)
+    {
+      std::cerr << "frame stream " << path_ << ": " << std::strerror(errno) << std::endl;
+    }
+    return fd;
+  }
+
+  pollfd pfd{listenFd_, POLLIN, 0};
+  while (not stop_)
+  {
+    if (::poll(&pfd, 1, kPollPeriodMs) <= 0)
+    {
+      continue; // timeout or a signal
+    }
+
+    const int fd = ::accept(listenFd_, nullptr, nullptr);
+    if (fd >= 0)
+    {
+      return fd;
+    }
+    if (errno != EINTR and errno != ECONNABORTED)
+    {
+      std::cerr << "frame stream " << path_ << ": " << std::strerror(errno) << std::endl;
+      return -1;
+    }
+  }
+  return -1;
+}
+
+bool StreamFrameSource::readFully(const int fd, void* data, size_t size)
+{
+  auto* bytes = static_cast<char*>(data);
+  pollfd pfd{fd, POLLIN, 0};
+  while (size > 0)
+  {
+    if (stop_)
+    {
+      return false;
+    }
+    if (::poll(&pfd, 1, kPollPeriodMs) <= 0)
+    {
+      continue; // timeout or a signal
+    }
+
+    const ssize_t n = ::read(fd, bytes, size);
+    if (n == 0)
+    {
+      return false; // the sender has disconnected
+    }
+    if (n < 0)
+    {
+      if (errno == EINTR or errno == EAGAIN)
+      {
+        continue;
+      }
+      return false;
+    }
+    bytes += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+
+std::unique_ptr<FrameSource> makeFrameSource(const std::string& source, const size_t streamBufferCapacity,
+                                             const std::string& imgPrefix, const std::string& imgFileType,
+                                             const std::string& lidarPrefix, const std::string& lidarFileType,
+                                             const int startIndex, const int endIndex, const int stepWidth,
+                                             const int fillWidth)
+{
+  if (source == "files")
+  {
+    return std::make_unique<FileFrameSource>(imgPrefix, imgFileType, lidarPrefix, lidarFileType,
+                                             startIndex, endIndex, stepWidth, fillWidth);
+  }
+  return std::make_unique<StreamFrameSource>(source, streamBufferCapacity);
+}
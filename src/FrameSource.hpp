@@ -0,0 +1,157 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_FRAMESOURCE_HPP
+#define CAMERA_FUSION_FRAMESOURCE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "dataStructures.h"
+
+
+// camera image and Lidar scan captured at the same time instance
+struct SensorFrame
+{
+  int index = 0; // frame number within the sequence
+  cv::Mat cameraImg;
+  std::vector<LidarPoint> lidarPoints; // the whole scan, not cropped
+};
+
+// sequence of sensor frames to be processed
+class FrameSource
+{
+public:
+
+  virtual ~FrameSource() = default;
+
+  // reads the next frame of the sequence; returns false once the sequence is over
+  virtual bool next(SensorFrame& frame) = 0;
+};
+
+// reads the frames from numbered image and Lidar files (e.g., the bundled KITTI sequence)
+class FileFrameSource : public FrameSource
+{
+public:
+
+  // a frame with the number i is read from imgPrefix + i + imgFileType and lidarPrefix + i + lidarFileType,
+  // where i runs from startIndex to endIndex with the given step and is zero-padded to fillWidth digits
+  FileFrameSource(std::string imgPrefix, std::string imgFileType, std::string lidarPrefix, std::string lidarFileType,
+                  int startIndex, int endIndex, int stepWidth, int fillWidth);
+
+  bool next(SensorFrame& frame) override;
+
+  // full paths of the image and the Lidar files of the frame with the given number
+  std::string imageFilename(int frameNumber) const;
+  std::string lidarFilename(int frameNumber) const;
+
+private:
+
+  const std::string imgPrefix_;
+  const std::string imgFileType_;
+  const std::string lidarPrefix_;
+  const std::string lidarFileType_;
+  const int startIndex_;
+  const int endIndex_;
+  const int stepWidth_;
+  const int fillWidth_;
+  int nextIndex_; // relative to startIndex_
+};
+
+// number of the last frame of a recording stored as numbered files, i.e., of the last image of the uninterrupted
+// run of files starting at startIndex; startIndex - 1 if there is no such image
+int findLastFrameNumber(const std::string& imgPrefix, const std::string& imgFileType, int startIndex, int fillWidth);
+
+// wire format of the streamed frames (all integers and floats in the host byte order): a FrameHeader followed by
+// imageBytes of an encoded image (any format cv::imdecode understands) and lidarPointCount * 4 floats x, y, z, r
+// (the layout of the KITTI velodyne files); a header with both sizes equal to zero marks the end of the stream
+struct FrameHeader
+{
+  static constexpr uint32_t kMagic = 0x4d52464bu; // "KFRM"
+
+  uint32_t magic = kMagic;
+  int32_t index = 0;
+  uint32_t imageBytes = 0;
+  uint32_t lidarPointCount = 0;
+};
+
+// writes a single frame (or the end-of-stream marker if both the image and the scan are empty) into the
+// file descriptor; throws std::runtime_error if the descriptor cannot be written to
+void writeStreamFrame(int fd, int index, const std::vector<uint8_t>& encodedImage,
+                      const std::vector<LidarPoint>& lidarPoints);
+
+// receives the frames from a named pipe ("fifo:PATH") or a Unix domain socket ("unix:PATH") the tracker listens on;
+// the frames are read by a background thread into a receive buffer of a bounded capacity, and while the buffer is
+// full the thread stops reading, so that the sender is slowed down instead of the memory growing without bounds;
+// when a sender disconnects, the source waits for the next one, until some sender transmits the end-of-stream marker
+class StreamFrameSource : public FrameSource
+{
+public:
+
+  StreamFrameSource(const std::string& endpoint, size_t bufferCapacity);
+  ~StreamFrameSource() override;
+
+  StreamFrameSource(const StreamFrameSource&) = delete;
+  StreamFrameSource& operator=(const StreamFrameSource&) = delete;
+
+  bool next(SensorFrame& frame) override;
+
+private:
+
+  void receive();
+  int waitForSender();
+  bool readFully(int fd, void* data, size_t size);
+
+  enum class Transport { kFifo, kUnixSocket };
+
+  Transport transport_;
+  std::string path_;
+  int listenFd_ = -1;
+  const size_t bufferCapacity_;
+
+  std::mutex mutex_;
+  std::condition_variable bufferNotEmpty_;
+  std::condition_variable bufferNotFull_;
+  std::deque<SensorFrame> buffer_;
+  bool endOfStream_ = false;
+  std::atomic<bool> stop_{false};
+  std::thread receiver_;
+};
+
+// creates the frame source for the given --source option value: "files" for the numbered files (the remaining
+// arguments describe them), "fifo:PATH" or "unix:PATH" for a stream
+std::unique_ptr<FrameSource> makeFrameSource(const std::string& source, size_t streamBufferCapacity,
+                                             const std::string& imgPrefix, const std::string& imgFileType,
+                                             const std::string& lidarPrefix, const std::string& lidarFileType,
+                                             int startIndex, int endIndex, int stepWidth, int fillWidth);
+
+#endif //CAMERA_FUSION_FRAMESOURCE_HPP
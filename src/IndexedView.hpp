@@ -0,0 +1,269 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_INDEXEDVIEW_HPP
+#define CAMERA_FUSION_INDEXEDVIEW_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+// read-only view of the elements of a vector selected by a vector of indices, or of all the elements of a vector;
+// the view refers to both vectors without copying them, so they must outlive it and must not be modified meanwhile
+template <typename T>
+class IndexedView
+{
+public:
+
+  // random-access iterator over the elements of the view
+  class const_iterator
+  {
+  private:
+    size_t pos_ = 0;
+    const IndexedView* view_ = nullptr;
+
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+    const_iterator(size_t pos, const IndexedView& view);
+
+    reference operator*() const;
+    pointer operator->() const;
+    reference operator[](difference_type diff) const;
+    bool operator==(const const_iterator& it) const;
+    bool operator!=(const const_iterator& it) const;
+    bool operator<(const const_iterator& it) const;
+    bool operator>(const const_iterator& it) const;
+    bool operator<=(const const_iterator& it) const;
+    bool operator>=(const const_iterator& it) const;
+    const_iterator& operator++();
+    const_iterator operator++(int);
+    const_iterator& operator--();
+    const_iterator operator--(int);
+    const_iterator& operator+=(difference_type diff);
+    const_iterator& operator-=(difference_type diff);
+    const_iterator operator+(difference_type diff) const;
+    const_iterator operator-(difference_type diff) const;
+    difference_type operator-(const const_iterator& it) const;
+
+    friend const_iterator operator+(const difference_type diff, const const_iterator& it)
+    {
+      return it + diff;
+    }
+  };
+
+  // all the elements of items
+  IndexedView(const std::vector<T>& items);
+
+  // the elements of items at the given indices, in the order of the indices
+  IndexedView(const std::vector<T>& items, const std::vector<size_t>& indices);
+
+  size_t size() const;
+
+  bool empty() const;
+
+  const T& operator[](size_t i) const;
+
+  const_iterator begin() const;
+
+  const_iterator end() const;
+
+private:
+
+  const std::vector<T>* items_;
+  const std::vector<size_t>* indices_; // nullptr for all the elements
+};
+
+template<typename T>
+IndexedView<T>::const_iterator::const_iterator(const size_t pos, const IndexedView& view) : pos_{pos}, view_{&view}
+{
+
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator*() const -> reference
+{
+  return (*view_)[pos_];
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator->() const -> pointer
+{
+  return &(*view_)[pos_];
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator[](const difference_type diff) const -> reference
+{
+  return *(*this + diff);
+}
+
+template<typename T>
+bool IndexedView<T>::const_iterator::operator==(const const_iterator& it) const
+{
+  return view_ == it.view_ and pos_ == it.pos_;
+}
+
+template<typename T>
+bool IndexedView<T>::const_iterator::operator!=(const const_iterator& it) const
+{
+  return not (*this == it);
+}
+
+template<typename T>
+bool IndexedView<T>::const_iterator::operator<(const const_iterator& it) const
+{
+  return pos_ < it.pos_;
+}
+
+template<typename T>
+bool IndexedView<T>::const_iterator::operator>(const const_iterator& it) const
+{
+  return it < *this;
+}
+
+template<typename T>
+bool IndexedView<T>::const_iterator::operator<=(const const_iterator& it) const
+{
+  return not (it < *this);
+}
+
+template<typename T>
+bool IndexedView<T>::const_iterator::operator>=(const const_iterator& it) const
+{
+  return not (*this < it);
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator++() -> const_iterator&
+{
+  ++pos_;
+  return *this;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator++(int) -> const_iterator
+{
+  const_iterator it = *this;
+  ++pos_;
+  return it;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator--() -> const_iterator&
+{
+  --pos_;
+  return *this;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator--(int) -> const_iterator
+{
+  const_iterator it = *this;
+  --pos_;
+  return it;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator+=(const difference_type diff) -> const_iterator&
+{
+  pos_ += diff;
+  return *this;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator-=(const difference_type diff) -> const_iterator&
+{
+  pos_ -= diff;
+  return *this;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator+(const difference_type diff) const -> const_iterator
+{
+  const_iterator it = *this;
+  return it += diff;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator-(const difference_type diff) const -> const_iterator
+{
+  const_iterator it = *this;
+  return it -= diff;
+}
+
+template<typename T>
+auto IndexedView<T>::const_iterator::operator-(const const_iterator& it) const -> difference_type
+{
+  return static_cast<difference_type>(pos_) - static_cast<difference_type>(it.pos_);
+}
+
+template<typename T>
+IndexedView<T>::IndexedView(const std::vector<T>& items) : items_{&items}, indices_{nullptr}
+{
+
+}
+
+template<typename T>
+IndexedView<T>::IndexedView(const std::vector<T>& items, const std::vector<size_t>& indices)
+  : items_{&items}, indices_{&indices}
+{
+
+}
+
+template<typename T>
+size_t IndexedView<T>::size() const
+{
+  return indices_ ? indices_->size() : items_->size();
+}
+
+template<typename T>
+bool IndexedView<T>::empty() const
+{
+  return size() == 0;
+}
+
+template<typename T>
+const T& IndexedView<T>::operator[](const size_t i) const
+{
+  return indices_ ? (*items_)[(*indices_)[i]] : (*items_)[i];
+}
+
+template<typename T>
+auto IndexedView<T>::begin() const -> const_iterator
+{
+  return const_iterator(0, *this);
+}
+
+template<typename T>
+auto IndexedView<T>::end() const -> const_iterator
+{
+  return const_iterator(size(), *this);
+}
+
+#endif //CAMERA_FUSION_INDEXEDVIEW_HPP
@@ -0,0 +1,139 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <opencv2/video/tracking.hpp>
+
+#include "KltTracker.hpp"
+
+using namespace std;
+
+
+KltTracker::KltTracker(KeypointPipeline& detector, const size_t minTrackedKeypoints,
+                       const float maxForwardBackwardError)
+  : detector_{detector}, minTrackedKeypoints_{minTrackedKeypoints}, maxForwardBackwardError_{maxForwardBackwardError}
+{
+
+}
+
+void KltTracker::track(FrameImages& prevImages, FrameImages& currImages, const vector<cv::KeyPoint>& prevKeypoints,
+                       vector<cv::KeyPoint>& currKeypoints, vector<cv::DMatch>& matches)
+{
+  const cv::Mat& currGray = currImages.gray();
+  currKeypoints.clear();
+  matches.clear();
+
+  if (not prevKeypoints.empty())
+  {
+    vector<cv::Point2f> prevPoints;
+    prevPoints.reserve(prevKeypoints.size());
+    for (const auto& keypoint : prevKeypoints)
+    {
+      prevPoints.push_back(keypoint.pt);
+    }
+
+    // both directions share the pyramids, and the current one serves again as the previous one in the next frame
+    const cv::Size windowSize(kWindowSize, kWindowSize);
+    const auto& prevPyramid = prevImages.flowPyramid(windowSize, kMaxLevel);
+    const auto& currPyramid = currImages.flowPyramid(windowSize, kMaxLevel);
+
+    vector<cv::Point2f> currPoints, backPoints;
+    vector<unsigned char> forwardStatus, backwardStatus;
+    vector<float> errors;
+    cv::calcOpticalFlowPyrLK(prevPyramid, currPyramid, prevPoints, currPoints, forwardStatus, errors,
+                             windowSize, kMaxLevel);
+    cv::calcOpticalFlowPyrLK(currPyramid, prevPyramid, currPoints, backPoints, backwardStatus, errors,
+                             windowSize, kMaxLevel);
+
+    for (size_t i = 0; i < prevPoints.size(); ++i)
+    {
+      const cv::Point2f& pt = currPoints[i];
+      if (not forwardStatus[i] or not backwardStatus[i] or
+          pt.x < 0 or pt.y < 0 or pt.x >= currGray.cols or pt.y >= currGray.rows or
+          cv::norm(backPoints[i] - prevPoints[i]) > maxForwardBackwardError_)
+      {
+        continue;
+      }
+
+      cv::KeyPoint keypoint = prevKeypoints[i];
+      keypoint.pt = pt;
+      matches.emplace_back(static_cast<int>(i), static_cast<int>(currKeypoints.size()), 0.0f);
+      currKeypoints.push_back(keypoint);
+    }
+  }
+
+  if (currKeypoints.size() < minTrackedKeypoints_)
+  {
+    redetect(currGray, currKeypoints);
+  }
+}
+
+void KltTracker::redetect(const cv::Mat& currGray, vector<cv::KeyPoint>& currKeypoints)
+{
+  vector<cv::KeyPoint> detected;
+  cv::Mat img = currGray; // the detector takes a non-const header
+  detector_.detect(img, detected);
+
+  // occupancy grid with cells of the min. distance; a detection is close to a tracked keypoint only if the latter
+  // lies in the same or a neighbouring cell
+  const int cols = static_cast<int>(std::ceil(currGray.cols / kMinKeypointDistance)) + 1;
+  const int rows = static_cast<int>(std::ceil(currGray.rows / kMinKeypointDistance)) + 1;
+  vector<vector<cv::Point2f>> grid(static_cast<size_t>(cols * rows));
+  const auto cellOf = [](const cv::Point2f& pt) {
+    return std::make_pair(static_cast<int>(pt.x / kMinKeypointDistance),
+                          static_cast<int>(pt.y / kMinKeypointDistance));
+  };
+  for (const auto& keypoint : currKeypoints)
+  {
+    const auto cell = cellOf(keypoint.pt);
+    grid[cell.second * cols + cell.first].push_back(keypoint.pt);
+  }
+
+  for (const auto& keypoint : detected)
+  {
+    const auto cell = cellOf(keypoint.pt);
+    bool bClose = false;
+    for (int y = std::max(0, cell.second - 1); y <= std::min(rows - 1, cell.second + 1) and not bClose; ++y)
+    {
+      for (int x = std::max(0, cell.first - 1); x <= std::min(cols - 1, cell.first + 1) and not bClose; ++x)
+      {
+        for (const auto& pt : grid[y * cols + x])
+        {
+          if (cv::norm(pt - keypoint.pt) < kMinKeypointDistance)
+          {
+            bClose = true;
+            break;
+          }
+        }
+      }
+    }
+    if (not bClose)
+    {
+      grid[cell.second * cols + cell.first].push_back(keypoint.pt);
+      currKeypoints.push_back(keypoint);
+    }
+  }
+}
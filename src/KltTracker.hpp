@@ -0,0 +1,68 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_KLTTRACKER_HPP
+#define CAMERA_FUSION_KLTTRACKER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "FrameImages.hpp"
+#include "matching2D.hpp"
+
+
+// tracks the keypoints of the previous frame into the current one with the pyramidal Lucas-Kanade optical flow
+// instead of detecting, describing and matching them anew; a track is kept only if tracking its new position
+// back into the previous frame returns close to where it started (forward-backward consistency), and new keypoints
+// are detected only once too few of them survive; the results have the layout of the descriptor matching: the
+// matches refer to the previous frame's keypoints by queryIdx and to the current frame's ones by trainIdx
+class KltTracker
+{
+public:
+
+  // the detector of the pipeline (re-)detects the keypoints
+  KltTracker(KeypointPipeline& detector, size_t minTrackedKeypoints, float maxForwardBackwardError);
+
+  // currKeypoints start with the tracked keypoints, followed by the newly detected ones, if any, which have
+  // no matches yet
+  // the pyramids of both frames come from (and stay in) the frames' image caches
+  void track(FrameImages& prevImages, FrameImages& currImages, const std::vector<cv::KeyPoint>& prevKeypoints,
+             std::vector<cv::KeyPoint>& currKeypoints, std::vector<cv::DMatch>& matches);
+
+private:
+
+  // adds the detections which are not close to the tracked keypoints
+  void redetect(const cv::Mat& currGray, std::vector<cv::KeyPoint>& currKeypoints);
+
+  static constexpr int kWindowSize = 21; // edge length of the search window at every pyramid level
+  static constexpr int kMaxLevel = 3;    // no. of pyramid levels above the image itself
+  static constexpr float kMinKeypointDistance = 5.0f; // min. distance of a new keypoint to the tracked ones
+
+  KeypointPipeline& detector_;
+  const size_t minTrackedKeypoints_;
+  const float maxForwardBackwardError_;
+};
+
+#endif //CAMERA_FUSION_KLTTRACKER_HPP
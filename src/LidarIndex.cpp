@@ -0,0 +1,248 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+#include "LidarIndex.hpp"
+
+
+static double squaredDistance(const LidarPoint& lhs, const LidarPoint& rhs)
+{
+  const double dx = lhs.x - rhs.x;
+  const double dy = lhs.y - rhs.y;
+  const double dz = lhs.z - rhs.z;
+  return dx * dx + dy * dy + dz * dz;
+}
+
+LidarIndex::LidarIndex(const std::vector<LidarPoint>& points, const float cellSize)
+  : points_{points}, cellSize_{cellSize}, minCell_{0, 0, 0}, maxCell_{-1, -1, -1}
+{
+  if (cellSize <= 0.0f)
+  {
+    throw std::invalid_argument("cell size must be positive");
+  }
+
+  // counting sort of the points by their cells: count, then turn the counts into ranges, then scatter
+  std::vector<uint64_t> keys(points_.size());
+  for (size_t i = 0; i < points_.size(); ++i)
+  {
+    const int c[3] = {cellCoordinate(points_[i].x), cellCoordinate(points_[i].y), cellCoordinate(points_[i].z)};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      minCell_[axis] = (i == 0) ? c[axis] : std::min(minCell_[axis], c[axis]);
+      maxCell_[axis] = (i == 0) ? c[axis] : std::max(maxCell_[axis], c[axis]);
+    }
+    keys[i] = cellKey(c[0], c[1], c[2]);
+    ++cells_[keys[i]].end;
+  }
+
+  size_t offset = 0;
+  for (auto& cell : cells_)
+  {
+    cell.second.begin = offset;
+    offset += cell.second.end;
+    cell.second.end = cell.second.begin;
+  }
+
+  order_.resize(points_.size());
+  for (size_t i = 0; i < points_.size(); ++i)
+  {
+    order_[cells_[keys[i]].end++] = i;
+  }
+}
+
+const std::vector<LidarPoint>& LidarIndex::points() const
+{
+  return points_;
+}
+
+void LidarIndex::radiusSearch(const LidarPoint& query, const float radius, std::vector<size_t>& indices) const
+{
+  indices.clear();
+  const double radius2 = static_cast<double>(radius) * radius;
+
+  const int lo[3] = {cellCoordinate(query.x - radius), cellCoordinate(query.y - radius), cellCoordinate(query.z - radius)};
+  const int hi[3] = {cellCoordinate(query.x + radius), cellCoordinate(query.y + radius), cellCoordinate(query.z + radius)};
+  for (int cx = std::max(lo[0], minCell_[0]); cx <= std::min(hi[0], maxCell_[0]); ++cx)
+  {
+    for (int cy = std::max(lo[1], minCell_[1]); cy <= std::min(hi[1], maxCell_[1]); ++cy)
+    {
+      for (int cz = std::max(lo[2], minCell_[2]); cz <= std::min(hi[2], maxCell_[2]); ++cz)
+      {
+        const Cell* cell = findCell(cx, cy, cz);
+        if (cell == nullptr)
+        {
+          continue;
+        }
+        for (size_t i = cell->begin; i < cell->end; ++i)
+        {
+          if (squaredDistance(points_[order_[i]], query) <= radius2)
+          {
+            indices.push_back(order_[i]);
+          }
+        }
+      }
+    }
+  }
+}
+
+void LidarIndex::knnSearch(const LidarPoint& query, const size_t k, std::vector<size_t>& indices) const
+{
+  indices.clear();
+  if (k == 0 or points_.empty())
+  {
+    return;
+  }
+
+  // the cells are visited in shells of growing Chebyshev distance from the query's cell; every point outside
+  // the shells visited so far lies at least ring * cellSize away from the query, so the search stops as soon as
+  // the k-th best distance is below that bound or all the occupied cells have been visited
+  const int qc[3] = {cellCoordinate(query.x), cellCoordinate(query.y), cellCoordinate(query.z)};
+  int maxRing = 0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    maxRing = std::max({maxRing, std::abs(qc[axis] - minCell_[axis]), std::abs(maxCell_[axis] - qc[axis])});
+  }
+
+  std::priority_queue<std::pair<double, size_t>> best; // max-heap of the k closest points found so far
+  for (int ring = 0; ring <= maxRing; ++ring)
+  {
+    for (int dx = -ring; dx <= ring; ++dx)
+    {
+      for (int dy = -ring; dy <= ring; ++dy)
+      {
+        // only the surface of the shell: inner cells have been visited already
+        const bool onSurface = std::abs(dx) == ring or std::abs(dy) == ring;
+        for (int dz = -ring; dz <= ring; dz += (onSurface or ring == 0) ? 1 : 2 * ring)
+        {
+          const Cell* cell = findCell(qc[0] + dx, qc[1] + dy, qc[2] + dz);
+          if (cell == nullptr)
+          {
+            continue;
+          }
+          for (size_t i = cell->begin; i < cell->end; ++i)
+          {
+            const double dist2 = squaredDistance(points_[order_[i]], query);
+            if (best.size() < k)
+            {
+              best.emplace(dist2, order_[i]);
+            }
+            else if (dist2 < best.top().first)
+            {
+              best.pop();
+              best.emplace(dist2, order_[i]);
+            }
+          }
+        }
+      }
+    }
+
+    const double bound = ring * cellSize_;
+    if (best.size() == k and best.top().first <= bound * bound)
+    {
+      break;
+    }
+  }
+
+  indices.resize(best.size());
+  for (auto it = indices.rbegin(); it != indices.rend(); ++it)
+  {
+    *it = best.top().second;
+    best.pop();
+  }
+}
+
+void LidarIndex::euclideanClusters(const std::vector<size_t>& subset, const float tolerance,
+                                   const size_t minClusterSize, std::vector<std::vector<size_t>>& clusters) const
+{
+  clusters.clear();
+
+  // the subset is kept sorted, so that the membership of a neighbour is a binary search away
+  std::vector<size_t> members(subset);
+  std::sort(members.begin(), members.end());
+  std::vector<bool> visited(members.size(), false);
+
+  std::vector<size_t> neighbours;
+  for (size_t seed = 0; seed < members.size(); ++seed)
+  {
+    if (visited[seed])
+    {
+      continue;
+    }
+
+    // breadth-first region growing from the seed point; the cluster itself serves as the queue
+    std::vector<size_t> cluster{members[seed]};
+    visited[seed] = true;
+    for (size_t head = 0; head < cluster.size(); ++head)
+    {
+      radiusSearch(points_[cluster[head]], tolerance, neighbours);
+      for (auto neighbour : neighbours)
+      {
+        const auto it = std::lower_bound(members.begin(), members.end(), neighbour);
+        if (it == members.end() or *it != neighbour)
+        {
+          continue;
+        }
+        const auto pos = static_cast<size_t>(it - members.begin());
+        if (not visited[pos])
+        {
+          visited[pos] = true;
+          cluster.push_back(neighbour);
+        }
+      }
+    }
+
+    if (cluster.size() >= minClusterSize)
+    {
+      clusters.push_back(std::move(cluster));
+    }
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const std::vector<size_t>& lhs, const std::vector<size_t>& rhs)
+                   {
+                     return lhs.size() > rhs.size();
+                   });
+}
+
+int LidarIndex::cellCoordinate(const double value) const
+{
+  return static_cast<int>(std::floor(value / cellSize_));
+}
+
+uint64_t LidarIndex::cellKey(const int cx, const int cy, const int cz)
+{
+  // 21 bits per axis are more than enough for any cell size above a millimetre
+  const auto bits = [](int c) { return static_cast<uint64_t>(c) & 0x1fffffu; };
+  return (bits(cx) << 42u) | (bits(cy) << 21u) | bits(cz);
+}
+
+const LidarIndex::Cell* LidarIndex::findCell(const int cx, const int cy, const int cz) const
+{
+  const auto it = cells_.find(cellKey(cx, cy, cz));
+  return it != cells_.end() ? &it->second : nullptr;
+}
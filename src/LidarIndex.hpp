@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_LIDARINDEX_HPP
+#define CAMERA_FUSION_LIDARINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "dataStructures.h"
+
+
+// spatial hash over a Lidar point cloud: the points are bucketed into cubic cells, and the points of every cell
+// are stored contiguously, so that the neighbour queries touch only the cells around the query point;
+// the index is built once per frame and keeps a reference to the cloud, which must outlive it and stay unchanged
+class LidarIndex
+{
+public:
+
+  // cellSize should be close to the typical query radius
+  LidarIndex(const std::vector<LidarPoint>& points, float cellSize);
+
+  const std::vector<LidarPoint>& points() const;
+
+  // indices of all points within the given distance from the query point, in no particular order
+  void radiusSearch(const LidarPoint& query, float radius, std::vector<size_t>& indices) const;
+
+  // indices of the k points closest to the query point (fewer if the cloud is smaller), nearest first
+  void knnSearch(const LidarPoint& query, size_t k, std::vector<size_t>& indices) const;
+
+  // splits the given subset of the points into clusters in which every point lies within the tolerance of some
+  // other point of the same cluster; only clusters of at least minClusterSize points are returned,
+  // the largest cluster first
+  void euclideanClusters(const std::vector<size_t>& subset, float tolerance, size_t minClusterSize,
+                         std::vector<std::vector<size_t>>& clusters) const;
+
+private:
+
+  struct Cell
+  {
+    size_t begin; // range of the cell's points in order_
+    size_t end;   //
+  };
+
+  int cellCoordinate(double value) const;
+  static uint64_t cellKey(int cx, int cy, int cz);
+  const Cell* findCell(int cx, int cy, int cz) const;
+
+  const std::vector<LidarPoint>& points_;
+  const double cellSize_;
+  std::unordered_map<uint64_t, Cell> cells_;
+  std::vector<size_t> order_; // point indices grouped by cell
+  int minCell_[3];            // bounds of the occupied cells along x, y and z
+  int maxCell_[3];            //
+};
+
+#endif //CAMERA_FUSION_LIDARINDEX_HPP
@@ -0,0 +1,77 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Options.hpp"
+
+
+Options ParseOptions(const int argc, const char* argv[], const std::vector<std::string>& validNames)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg{argv[i]};
+    const auto eqPos = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 or eqPos == std::string::npos)
+    {
+      throw std::invalid_argument("malformed option (expected --name=value): " + arg);
+    }
+    const std::string name = arg.substr(2, eqPos - 2);
+    if (std::find(validNames.begin(), validNames.end(), name) == validNames.end())
+    {
+      std::string message = "unknown option --" + name + ", the valid options are:";
+      for (const auto& validName : validNames)
+      {
+        message += " --" + validName;
+      }
+      throw std::invalid_argument(message);
+    }
+    options[name] = arg.substr(eqPos + 1);
+  }
+
+  return options;
+}
+
+std::string GetOption(const Options& options, const std::string& name, const std::string& defaultValue)
+{
+  const auto it = options.find(name);
+  return it == options.end() ? defaultValue : it->second;
+}
+
+std::vector<std::string> SplitOptionList(const std::string& value)
+{
+  std::vector<std::string> items;
+  size_t begin = 0;
+  while (begin <= value.size())
+  {
+    const size_t end = std::min(value.find(',', begin), value.size());
+    if (end > begin)
+    {
+      items.push_back(value.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return items;
+}
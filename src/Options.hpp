@@ -0,0 +1,43 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_OPTIONS_HPP
+#define CAMERA_FUSION_OPTIONS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+using Options = std::map<std::string, std::string>;
+
+// parses the command line options of the form --name=value; throws std::invalid_argument if an option is malformed
+// or not among the valid names, so that a mistyped option does not silently fall back to the default
+Options ParseOptions(int argc, const char* argv[], const std::vector<std::string>& validNames);
+
+std::string GetOption(const Options& options, const std::string& name, const std::string& defaultValue);
+
+// splits a comma-separated option value into its non-empty items
+std::vector<std::string> SplitOptionList(const std::string& value);
+
+#endif //CAMERA_FUSION_OPTIONS_HPP
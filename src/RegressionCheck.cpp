@@ -0,0 +1,368 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// compares the results of a run of 3D_object_tracking on the bundled frames (the <combination>.csv it writes) with
+// the golden results recorded for the combination; exits with 1 on a regression or if no golden results have been
+// recorded; options:
+//   --results=PATH     CSV file written by the run (required)
+//   --golden=PATH      golden TTC of every track at every frame: frame_index,track_id,ttc_lidar,ttc_camera (required)
+//   --timing=PATH      baseline mean latency of every stage per frame: column,ms (required)
+//   --ttc-abs-tol=S    TTC deviation from the golden value tolerated in any case, in seconds (default: 0.05)
+//   --ttc-rel-tol=R    TTC deviation tolerated relative to the golden value (default: 0.02)
+//   --max-slowdown=F   max. relative increase of the mean latency of a stage over the baseline, e.g., 0.25 for 25%;
+//                      a negative value disables the timing check, which is only meaningful on the machine
+//                      the baseline has been recorded on (default: -1)
+//   --min-slowdown-ms=T    increases of the mean latency by at most T ms are never regressions (default: 1)
+//   --update=0|1       record the results as the new golden values and timing baseline instead (default: 0)
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Options.hpp"
+
+
+// the loading of the frames is dominated by the disk and is not checked against the baseline
+const std::string kIgnoredLatencyColumn = "latency_LOAD_ms";
+
+// a CSV file as the names of its columns and its rows of fields
+struct Table
+{
+  std::vector<std::string> columns;
+  std::vector<std::vector<std::string>> rows;
+
+  size_t column(const std::string& name) const
+  {
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+      if (columns[i] == name)
+      {
+        return i;
+      }
+    }
+    throw std::runtime_error("no column " + name);
+  }
+};
+
+static std::vector<std::string> splitFields(const std::string& line)
+{
+  std::vector<std::string> fields;
+  std::istringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, ','))
+  {
+    fields.push_back(field);
+  }
+  if (not line.empty() and line.back() == ',')
+  {
+    fields.emplace_back();
+  }
+  return fields;
+}
+
+static Table readTable(const std::string& path)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    throw std::runtime_error("cannot open " + path);
+  }
+
+  Table table;
+  std::string line;
+  if (std::getline(in, line))
+  {
+    table.columns = splitFields(line);
+  }
+  while (std::getline(in, line))
+  {
+    if (line.empty())
+    {
+      continue;
+    }
+    table.rows.push_back(splitFields(line));
+    if (table.rows.back().size() != table.columns.size())
+    {
+      throw std::runtime_error(path + " has a row with " + std::to_string(table.rows.back().size()) +
+                               " fields instead of " + std::to_string(table.columns.size()));
+    }
+  }
+  return table;
+}
+
+// the fields of undefined values (NaN) are empty
+static double toValue(const std::string& field)
+{
+  return field.empty() ? std::numeric_limits<double>::quiet_NaN() : std::stod(field);
+}
+
+static std::string toField(const double value)
+{
+  if (std::isnan(value))
+  {
+    return "";
+  }
+  std::ostringstream out;
+  out << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+  return out.str();
+}
+
+static bool fileExists(const std::string& path)
+{
+  return std::ifstream(path).good();
+}
+
+using TrackKey = std::pair<int, int>; // frame index, track id
+using TrackTtc = std::pair<double, double>; // Lidar, Camera
+
+static std::map<TrackKey, TrackTtc> readTtc(const Table& table)
+{
+  const size_t frameColumn = table.column("frame_index");
+  const size_t trackColumn = table.column("track_id");
+  const size_t lidarColumn = table.column("ttc_lidar");
+  const size_t cameraColumn = table.column("ttc_camera");
+
+  std::map<TrackKey, TrackTtc> ttc;
+  for (const auto& row : table.rows)
+  {
+    ttc[{std::stoi(row[frameColumn]), std::stoi(row[trackColumn])}] =
+        {toValue(row[lidarColumn]), toValue(row[cameraColumn])};
+  }
+  return ttc;
+}
+
+// mean latency of every stage per frame; every track of a frame has a record with the latencies of the frame
+static std::map<std::string, double> meanLatencies(const Table& table)
+{
+  const size_t frameColumn = table.column("frame_index");
+  std::set<std::string> frames;
+  std::map<std::string, double> sums;
+  for (const auto& row : table.rows)
+  {
+    if (not frames.insert(row[frameColumn]).second)
+    {
+      continue;
+    }
+    for (size_t i = 0; i < table.columns.size(); ++i)
+    {
+      const std::string& name = table.columns[i];
+      if (name.compare(0, 8, "latency_") == 0)
+      {
+        sums[name] += toValue(row[i]);
+      }
+    }
+  }
+
+  for (auto& sum : sums)
+  {
+    sum.second /= static_cast<double>(frames.size());
+  }
+  return sums;
+}
+
+// equal within the tolerances; undefined and infinite values must be the same
+static bool ttcMatches(const double value, const double golden, const double absTol, const double relTol)
+{
+  if (std::isnan(value) or std::isnan(golden))
+  {
+    return std::isnan(value) and std::isnan(golden);
+  }
+  if (std::isinf(value) or std::isinf(golden))
+  {
+    return value == golden;
+  }
+  return std::abs(value - golden) <= absTol + relTol * std::abs(golden);
+}
+
+static void writeGolden(const std::string& path, const std::map<TrackKey, TrackTtc>& ttc)
+{
+  std::ofstream out(path);
+  if (!out)
+  {
+    throw std::runtime_error("cannot write " + path);
+  }
+  out << "frame_index,track_id,ttc_lidar,ttc_camera\n";
+  for (const auto& track : ttc)
+  {
+    out << track.first.first << ',' << track.first.second << ','
+        << toField(track.second.first) << ',' << toField(track.second.second) << '\n';
+  }
+}
+
+static void writeTiming(const std::string& path, const std::map<std::string, double>& latencies)
+{
+  std::ofstream out(path);
+  if (!out)
+  {
+    throw std::runtime_error("cannot write " + path);
+  }
+  out << "column,ms\n";
+  for (const auto& latency : latencies)
+  {
+    out << latency.first << ',' << toField(latency.second) << '\n';
+  }
+}
+
+// returns the number of the tracks whose TTC deviate from the golden ones, or are missing or extra
+static size_t checkTtc(const std::map<TrackKey, TrackTtc>& ttc, const std::map<TrackKey, TrackTtc>& golden,
+                       const double absTol, const double relTol)
+{
+  size_t failures = 0;
+  for (const auto& expected : golden)
+  {
+    const int frame = expected.first.first, track = expected.first.second;
+    const auto actual = ttc.find(expected.first);
+    if (actual == ttc.end())
+    {
+      std::cout << "frame " << frame << ", track " << track << ": missing" << std::endl;
+      ++failures;
+      continue;
+    }
+
+    const bool lidarMatches = ttcMatches(actual->second.first, expected.second.first, absTol, relTol);
+    const bool cameraMatches = ttcMatches(actual->second.second, expected.second.second, absTol, relTol);
+    if (not lidarMatches or not cameraMatches)
+    {
+      std::cout << "frame " << frame << ", track " << track << ": TTC Lidar " << actual->second.first
+                << " s (golden " << expected.second.first << " s), TTC Camera " << actual->second.second
+                << " s (golden " << expected.second.second << " s)" << std::endl;
+      ++failures;
+    }
+  }
+
+  for (const auto& actual : ttc)
+  {
+    if (golden.find(actual.first) == golden.end())
+    {
+      std::cout << "frame " << actual.first.first << ", track " << actual.first.second << ": not in the golden results"
+                << std::endl;
+      ++failures;
+    }
+  }
+  return failures;
+}
+
+// returns the number of the stages slower than the baseline beyond the threshold
+static size_t checkTiming(const std::map<std::string, double>& latencies, const std::map<std::string, double>& baseline,
+                          const double maxSlowdown, const double minSlowdownMs)
+{
+  size_t failures = 0;
+  for (const auto& expected : baseline)
+  {
+    if (expected.first == kIgnoredLatencyColumn)
+    {
+      continue;
+    }
+
+    const auto actual = latencies.find(expected.first);
+    if (actual == latencies.end())
+    {
+      std::cout << expected.first << ": missing" << std::endl;
+      ++failures;
+      continue;
+    }
+
+    const double slowdownMs = actual->second - expected.second;
+    const bool bRegressed = slowdownMs > minSlowdownMs and slowdownMs > maxSlowdown * expected.second;
+    std::cout << expected.first << ": " << actual->second << " ms per frame (baseline " << expected.second << " ms)"
+              << (bRegressed ? " REGRESSION" : "") << std::endl;
+    failures += bRegressed ? 1 : 0;
+  }
+  return failures;
+}
+
+int main(int argc, const char* argv[])
+{
+  const auto options = ParseOptions(argc, argv, {"results", "golden", "timing", "ttc-abs-tol", "ttc-rel-tol",
+                                                 "max-slowdown", "min-slowdown-ms", "update"});
+  const std::string resultsPath = GetOption(options, "results", "");
+  const std::string goldenPath = GetOption(options, "golden", "");
+  const std::string timingPath = GetOption(options, "timing", "");
+  const double absTol = std::stod(GetOption(options, "ttc-abs-tol", "0.05"));
+  const double relTol = std::stod(GetOption(options, "ttc-rel-tol", "0.02"));
+  const double maxSlowdown = std::stod(GetOption(options, "max-slowdown", "-1"));
+  const double minSlowdownMs = std::stod(GetOption(options, "min-slowdown-ms", "1"));
+  const bool bUpdate = std::stoi(GetOption(options, "update", "0")) != 0;
+  if (resultsPath.empty() or goldenPath.empty() or timingPath.empty())
+  {
+    throw std::invalid_argument("--results, --golden and --timing are required");
+  }
+
+  const Table results = readTable(resultsPath);
+  const auto ttc = readTtc(results);
+  const auto latencies = meanLatencies(results);
+
+  if (bUpdate)
+  {
+    writeGolden(goldenPath, ttc);
+    writeTiming(timingPath, latencies);
+    std::cout << "recorded " << ttc.size() << " golden track measurements in " << goldenPath
+              << " and the timing baseline in " << timingPath << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (not fileExists(goldenPath))
+  {
+    std::cout << "no golden results recorded in " << goldenPath
+              << ", record them with the update_regression_baselines target" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const size_t ttcFailures = checkTtc(ttc, readTtc(readTable(goldenPath)), absTol, relTol);
+  std::cout << ttc.size() << " track measurements, " << ttcFailures << " deviating from the golden results"
+            << std::endl;
+
+  size_t timingFailures = 0;
+  if (maxSlowdown < 0.0)
+  {
+    std::cout << "timing check disabled" << std::endl;
+  }
+  else if (not fileExists(timingPath))
+  {
+    std::cout << "no timing baseline recorded in " << timingPath << std::endl;
+  }
+  else
+  {
+    std::map<std::string, double> baseline;
+    const Table baselineTable = readTable(timingPath);
+    const size_t nameColumn = baselineTable.column("column");
+    const size_t msColumn = baselineTable.column("ms");
+    for (const auto& row : baselineTable.rows)
+    {
+      baseline[row[nameColumn]] = toValue(row[msColumn]);
+    }
+    timingFailures = checkTiming(latencies, baseline, maxSlowdown, minSlowdownMs);
+  }
+
+  return ttcFailures == 0 and timingFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_RESOURCEPOOL_HPP
+#define CAMERA_FUSION_RESOURCEPOOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+
+// bounded pool of expensive objects (e.g., loaded networks) shared by worker threads; the objects are created
+// lazily, at most maxSize of them, and a checkout waits while all of them are in use
+template <typename T>
+class ResourcePool
+{
+public:
+
+  using Factory = std::function<std::unique_ptr<T>()>;
+
+  // exclusive use of a pooled object; the object returns to the pool when the lease is destroyed
+  using Lease = std::unique_ptr<T, std::function<void(T*)>>;
+
+  ResourcePool(Factory factory, size_t maxSize);
+
+  ResourcePool(const ResourcePool&) = delete;
+  ResourcePool& operator=(const ResourcePool&) = delete;
+
+  Lease checkout();
+
+  // no. of objects created so far
+  size_t size() const;
+
+  size_t max_size() const;
+
+private:
+
+  void checkin(T* object);
+
+  const Factory factory_;
+  const size_t maxSize_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable available_;
+  std::vector<std::unique_ptr<T>> objects_; // all the created objects
+  std::vector<T*> idle_;                    // the objects not checked out
+};
+
+template<typename T>
+ResourcePool<T>::ResourcePool(Factory factory, const size_t maxSize) : factory_{std::move(factory)}, maxSize_{maxSize}
+{
+  if (maxSize_ == 0)
+  {
+    throw std::invalid_argument("resource pool size must be positive");
+  }
+}
+
+template<typename T>
+auto ResourcePool<T>::checkout() -> Lease
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  available_.wait(lock, [this] { return not idle_.empty() or objects_.size() < maxSize_; });
+
+  T* object;
+  if (not idle_.empty())
+  {
+    object = idle_.back();
+    idle_.pop_back();
+  }
+  else
+  {
+    // the slot is reserved before the lock is released, so that the pool never exceeds its size
+    objects_.emplace_back();
+    lock.unlock();
+    std::unique_ptr<T> created;
+    try
+    {
+      created = factory_();
+    }
+    catch (...)
+    {
+      lock.lock();
+      objects_.erase(std::find(objects_.begin(), objects_.end(), nullptr));
+      available_.notify_one();
+      throw;
+    }
+    object = created.get();
+    lock.lock();
+    *std::find(objects_.begin(), objects_.end(), nullptr) = std::move(created);
+  }
+  return Lease(object, [this](T* returned) { checkin(returned); });
+}
+
+template<typename T>
+void ResourcePool<T>::checkin(T* object)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(object);
+  }
+  available_.notify_one();
+}
+
+template<typename T>
+size_t ResourcePool<T>::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return objects_.size();
+}
+
+template<typename T>
+size_t ResourcePool<T>::max_size() const
+{
+  return maxSize_;
+}
+
+#endif //CAMERA_FUSION_RESOURCEPOOL_HPP
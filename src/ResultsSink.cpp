@@ -0,0 +1,315 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "ResultsSink.hpp"
+
+using namespace std;
+
+
+void StageTimer::start()
+{
+  fill(begin(ms_), end(ms_), 0.0);
+  lastTick_ = cv::getTickCount();
+}
+
+void StageTimer::lap(Stage stage)
+{
+  const int64_t tick = cv::getTickCount();
+  ms_[stage] = 1000.0 * static_cast<double>(tick - lastTick_) / cv::getTickFrequency();
+  lastTick_ = tick;
+}
+
+double StageTimer::ms(Stage stage) const
+{
+  return ms_[stage];
+}
+
+namespace
+{
+template<typename T> constexpr char ColumnType();
+template<> constexpr char ColumnType<int32_t>() { return 'i'; }
+template<> constexpr char ColumnType<double>() { return 'd'; }
+
+constexpr uint32_t kNumOfResultColumns = RESULT_COLUMNS(MAP_TO_ONE, PLUS) + num_of_stages;
+
+void WriteRaw(ofstream& file, const void* data, size_t size)
+{
+  file.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+}
+
+void WriteColumnHeader(ofstream& file, const string& name, char type)
+{
+  const auto nameLength = static_cast<uint8_t>(name.size());
+  WriteRaw(file, &nameLength, sizeof(nameLength));
+  WriteRaw(file, name.data(), name.size());
+  WriteRaw(file, &type, sizeof(type));
+}
+
+string LatencyColumnName(size_t stage)
+{
+  return string("latency_") + stage_names[stage] + "_ms";
+}
+} // namespace
+
+ResultsSink::ResultsSink(const string& path, size_t batchSize)
+  : path_(path), file_(path, ios::binary), batchSize_(batchSize)
+{
+  if (!file_)
+  {
+    throw runtime_error("cannot open the results file " + path);
+  }
+  if (batchSize_ == 0)
+  {
+    throw invalid_argument("the batch size of the results sink must be positive");
+  }
+  batch_.reserve(batchSize_);
+  writer_ = thread(&ResultsSink::writeLoop, this);
+}
+
+ResultsSink::~ResultsSink()
+{
+  submit();
+  {
+    lock_guard<mutex> lock(mutex_);
+    done_ = true;
+  }
+  batchesPending_.notify_one();
+  writer_.join();
+}
+
+void ResultsSink::add(const ResultRecord& record)
+{
+  batch_.push_back(record);
+  if (batch_.size() >= batchSize_)
+  {
+    submit();
+  }
+}
+
+void ResultsSink::flush()
+{
+  submit();
+  unique_lock<mutex> lock(mutex_);
+  batchesWritten_.wait(lock, [this] { return pending_.empty() and !writing_; });
+  if (writeFailed_)
+  {
+    throw runtime_error("cannot write to the results file " + path_);
+  }
+}
+
+void ResultsSink::submit()
+{
+  if (batch_.empty())
+  {
+    return;
+  }
+  {
+    lock_guard<mutex> lock(mutex_);
+    pending_.push_back(move(batch_));
+  }
+  batchesPending_.notify_one();
+  batch_ = vector<ResultRecord>();
+  batch_.reserve(batchSize_);
+}
+
+void ResultsSink::writeLoop()
+{
+  unique_lock<mutex> lock(mutex_);
+  while (true)
+  {
+    batchesPending_.wait(lock, [this] { return done_ or !pending_.empty(); });
+    if (pending_.empty())
+    {
+      return; // done, and everything has been written
+    }
+    auto batch = move(pending_.front());
+    pending_.pop_front();
+    writing_ = true;
+    lock.unlock();
+    const bool written = writeBlock(batch);
+    lock.lock();
+    writeFailed_ = writeFailed_ or !written;
+    writing_ = false;
+    batchesWritten_.notify_all();
+  }
+}
+
+bool ResultsSink::writeBlock(const vector<ResultRecord>& batch)
+{
+  if (!file_)
+  {
+    return false; // an earlier block has failed
+  }
+
+  const uint32_t header[]{kBlockMagic, static_cast<uint32_t>(batch.size()), kNumOfResultColumns};
+  WriteRaw(file_, header, sizeof(header));
+
+  // transposes the rows of the batch into a column at a time
+#define WRITE_RESULT_COLUMN(type, name)                                  \
+  {                                                                      \
+    WriteColumnHeader(file_, #name, ColumnType<type>());                 \
+    vector<type> column(batch.size());                                   \
+    for (size_t row = 0; row < batch.size(); ++row)                      \
+    {                                                                    \
+      column[row] = batch[row].name;                                     \
+    }                                                                    \
+    WriteRaw(file_, column.data(), column.size() * sizeof(type));        \
+  }
+  RESULT_COLUMNS(WRITE_RESULT_COLUMN, EMPTY)
+#undef WRITE_RESULT_COLUMN
+
+  vector<double> column(batch.size());
+  for (size_t stage = 0; stage < num_of_stages; ++stage)
+  {
+    WriteColumnHeader(file_, LatencyColumnName(stage), ColumnType<double>());
+    for (size_t row = 0; row < batch.size(); ++row)
+    {
+      column[row] = batch[row].latency_ms[stage];
+    }
+    WriteRaw(file_, column.data(), column.size() * sizeof(double));
+  }
+  file_.flush();
+  return static_cast<bool>(file_);
+}
+
+void ExportResultsCsv(const string& binaryPath, const string& csvPath)
+{
+  ifstream in(binaryPath, ios::binary);
+  if (!in)
+  {
+    throw runtime_error("cannot open the results file " + binaryPath);
+  }
+  ofstream out(csvPath);
+  if (!out)
+  {
+    throw runtime_error("cannot open the CSV file " + csvPath);
+  }
+
+  // the columns written as names of the algorithms rather than as their enum values, with the no. of the names
+  const auto namesOf = [](const string& column) -> pair<const char* const*, size_t> {
+    if (column == "detector") return {detector_names, num_of_detectors};
+    if (column == "descriptor") return {descriptor_names, num_of_descriptors};
+    if (column == "descriptor_type") return {descriptor_type_names, num_of_descriptor_types};
+    if (column == "matcher") return {matcher_names, num_of_matchers};
+    if (column == "selector") return {selector_names, num_of_selectors};
+    return {nullptr, 0};
+  };
+  const auto read = [&in, &binaryPath](void* data, size_t size) {
+    in.read(static_cast<char*>(data), static_cast<streamsize>(size));
+    if (static_cast<size_t>(in.gcount()) != size)
+    {
+      throw runtime_error("the results file " + binaryPath + " is truncated");
+    }
+  };
+
+  struct Column
+  {
+    string name;
+    char type;
+    vector<char> data;
+  };
+  bool headerWritten = false;
+  uint32_t header[3];
+  while (in.peek() != char_traits<char>::eof())
+  {
+    read(header, sizeof(header));
+    const uint32_t rows = header[1], columnCount = header[2];
+    if (header[0] != ResultsSink::kBlockMagic)
+    {
+      throw runtime_error("the results file " + binaryPath + " has a corrupted block");
+    }
+
+    vector<Column> columns(columnCount);
+    for (auto& column : columns)
+    {
+      uint8_t nameLength;
+      read(&nameLength, sizeof(nameLength));
+      column.name.resize(nameLength);
+      read(&column.name[0], nameLength);
+      read(&column.type, sizeof(column.type));
+      if (column.type != 'i' and column.type != 'd')
+      {
+        throw runtime_error("the results file " + binaryPath + " has a column of unknown type");
+      }
+      column.data.resize(rows * (column.type == 'i' ? sizeof(int32_t) : sizeof(double)));
+      read(column.data.data(), column.data.size());
+    }
+
+    if (!headerWritten)
+    {
+      for (size_t col = 0; col < columns.size(); ++col)
+      {
+        out << (col ? "," : "") << columns[col].name;
+      }
+      out << '\n';
+      headerWritten = true;
+    }
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+      for (size_t col = 0; col < columns.size(); ++col)
+      {
+        const auto& column = columns[col];
+        out << (col ? "," : "");
+        if (column.type == 'i')
+        {
+          int32_t value;
+          memcpy(&value, column.data.data() + row * sizeof(value), sizeof(value));
+          const auto names = namesOf(column.name);
+          if (names.first)
+          {
+            if (value < 0 or static_cast<size_t>(value) >= names.second)
+            {
+              throw runtime_error("the results file " + binaryPath + " has an unknown " + column.name);
+            }
+            out << names.first[value];
+          }
+          else
+          {
+            out << value;
+          }
+        }
+        else
+        {
+          double value;
+          memcpy(&value, column.data.data() + row * sizeof(value), sizeof(value));
+          if (!isnan(value))
+          {
+            out << value; // missing values are left empty
+          }
+        }
+      }
+      out << '\n';
+    }
+  }
+
+  out.flush();
+  if (!out)
+  {
+    throw runtime_error("cannot write to the CSV file " + csvPath);
+  }
+}
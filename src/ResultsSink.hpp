@@ -0,0 +1,153 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_RESULTSSINK_HPP
+#define CAMERA_FUSION_RESULTSSINK_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "dataStructures.h"
+
+
+/* a list of the stages of the per-frame processing, in the order they run */
+#define STAGES(action, arg, sep)               \
+        action(arg, LOAD)                  sep \
+        action(arg, DETECT_KEYPOINTS)      sep \
+        action(arg, DESCRIBE_KEYPOINTS)    sep \
+        action(arg, MATCH_KEYPOINTS)       sep \
+        action(arg, DETECT_OBJECTS)        sep \
+        action(arg, CROP_LIDAR)            sep \
+        action(arg, CLUSTER_LIDAR)         sep \
+        action(arg, TRACK_OBJECTS)         sep \
+        action(arg, COMPUTE_TTC)
+DECLARE_VARIABLES(STAGES, stage, Stage);
+
+// measures the latencies of the consecutive stages of a frame
+class StageTimer
+{
+public:
+
+  // starts timing the first stage of a frame
+  void start();
+
+  // ends the given stage and starts timing the next one
+  void lap(Stage stage);
+
+  // latency of the given stage of the current frame in milliseconds, 0 if the stage has not run
+  double ms(Stage stage) const;
+
+private:
+
+  int64_t lastTick_ = 0;
+  double ms_[num_of_stages] = {};
+};
+
+/* a list of the columns of a result record: type, name */
+#define RESULT_COLUMNS(action, sep)                   \
+        action(int32_t, frame_index)              sep \
+        action(int32_t, track_id)                 sep \
+        action(int32_t, detector)                 sep \
+        action(int32_t, descriptor)               sep \
+        action(int32_t, descriptor_type)          sep \
+        action(int32_t, matcher)                  sep \
+        action(int32_t, selector)                 sep \
+        action(double,  ttc_lidar)                sep \
+        action(double,  ttc_camera)               sep \
+        action(double,  ttc_fused)                sep \
+        action(int32_t, frame_keypoints)          sep \
+        action(int32_t, frame_matches)            sep \
+        action(int32_t, box_matches)              sep \
+        action(int32_t, box_lidar_points)         sep \
+        action(int32_t, degradation_level)        sep \
+        action(int32_t, deadline_miss)
+
+#define DECLARE_RESULT_FIELD(type, name) type name;
+
+// measurements of a single track at a single frame, together with the frame's metrics
+struct ResultRecord
+{
+  RESULT_COLUMNS(DECLARE_RESULT_FIELD, EMPTY)
+  double latency_ms[num_of_stages]; // stored as the columns latency_<STAGE>_ms
+};
+
+#undef DECLARE_RESULT_FIELD
+
+// writes the result records to a compact columnar binary file; the records are buffered in batches, which are
+// written by a background thread, so that the processing loop only appends to an in-memory vector;
+// the file is a sequence of blocks, one per batch:
+//   uint32 magic "TTCB", uint32 number of rows, uint32 number of columns, and for every column
+//   uint8 name length, name, char type ('i' int32, 'd' float64), the values of all the rows
+// (all in the host byte order), which is readable with a few lines of numpy
+class ResultsSink
+{
+public:
+
+  static constexpr uint32_t kBlockMagic = 0x42435454u; // "TTCB"
+
+  explicit ResultsSink(const std::string& path, size_t batchSize = 1024);
+  ~ResultsSink();
+
+  ResultsSink(const ResultsSink&) = delete;
+  ResultsSink& operator=(const ResultsSink&) = delete;
+
+  void add(const ResultRecord& record);
+
+  // hands the buffered records over to the writer and waits until everything has been written;
+  // throws std::runtime_error if some block could not be written, e.g., because the disk is full
+  void flush();
+
+private:
+
+  void submit();
+  void writeLoop();
+  bool writeBlock(const std::vector<ResultRecord>& batch);
+
+  const std::string path_;
+  std::ofstream file_;
+  const size_t batchSize_;
+  std::vector<ResultRecord> batch_; // records being collected by the processing loop
+
+  std::mutex mutex_;
+  std::condition_variable batchesPending_;
+  std::condition_variable batchesWritten_;
+  std::deque<std::vector<ResultRecord>> pending_; // batches waiting for the writer
+  bool writing_ = false;
+  bool done_ = false;
+  bool writeFailed_ = false; // the file is incomplete, the later blocks are not written either
+  std::thread writer_;
+};
+
+// converts a file written by ResultsSink to CSV; the configuration columns are written as the names of the
+// algorithms; throws std::runtime_error if the file is malformed
+void ExportResultsCsv(const std::string& binaryPath, const std::string& csvPath);
+
+#endif //CAMERA_FUSION_RESULTSSINK_HPP
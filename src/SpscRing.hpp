@@ -0,0 +1,294 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_SPSCRING_HPP
+#define CAMERA_FUSION_SPSCRING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+
+// how the blocking operations of SpscRing wait for the other side: busy-spin first, then yield the core,
+// and finally park the thread on a condition variable, which the other side signals only when it sees a parked thread
+struct SpscWaitPolicy
+{
+  size_t spinIterations = 1024;
+  size_t yieldIterations = 64;
+  std::chrono::microseconds parkTimeout{200}; // bounds the wait if a wake-up is missed
+};
+
+// fixed-capacity ring for handing elements over from exactly one producer thread to exactly one consumer thread;
+// unlike CircularBuffer it never overwrites: a push into a full ring fails or waits; the hot path is lock-free,
+// the head and the tail indices live on separate cache lines and each side caches the other side's index
+template <typename T, size_t N>
+class SpscRing
+{
+
+  static_assert( N > 0, "SpscRing capacity must be greater than zero." );
+
+public:
+
+  explicit SpscRing(SpscWaitPolicy policy = SpscWaitPolicy{});
+  ~SpscRing();
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  constexpr static size_t max_size();
+
+  // producer side; the element is moved (copied) only if there is room for it
+  bool try_push(T&& value);
+  bool try_push(const T& value);
+
+  // producer side; waits for room; returns false only if the ring has been closed
+  bool push(T&& value);
+
+  // consumer side; the element is moved out of the ring
+  bool try_pop(T& value);
+
+  // consumer side; waits for an element; returns false once the ring is closed and drained
+  bool pop(T& value);
+
+  // wakes up the blocked sides; the remaining elements can still be popped
+  void close();
+
+  bool closed() const;
+
+  // approximate when called concurrently with the other side
+  size_t size() const;
+
+private:
+
+  static constexpr size_t kCacheLine = 64;
+
+  template <typename U>
+  bool tryPushImpl(U&& value);
+
+  template <typename Ready>
+  void wait(std::atomic<bool>& parked, Ready ready);
+
+  void wake(std::atomic<bool>& parked);
+
+  T* slot(size_t index);
+
+  const SpscWaitPolicy policy_;
+  alignas(T) unsigned char storage_[N][sizeof(T)];
+
+  alignas(kCacheLine) std::atomic<size_t> head_{0}; // next element to pop, written by the consumer only
+  size_t cachedTail_ = 0;                           // consumer's copy of tail_
+
+  alignas(kCacheLine) std::atomic<size_t> tail_{0}; // next free slot, written by the producer only
+  size_t cachedHead_ = 0;                           // producer's copy of head_
+
+  alignas(kCacheLine) std::atomic<bool> closed_{false};
+  std::atomic<bool> producerParked_{false};
+  std::atomic<bool> consumerParked_{false};
+  std::mutex parkMutex_;
+  std::condition_variable parkCondition_;
+};
+
+template<typename T, size_t N>
+SpscRing<T, N>::SpscRing(const SpscWaitPolicy policy) : policy_{policy}
+{
+
+}
+
+template<typename T, size_t N>
+SpscRing<T, N>::~SpscRing()
+{
+  for (size_t index = head_.load(std::memory_order_relaxed); index != tail_.load(std::memory_order_relaxed); ++index)
+  {
+    slot(index)->~T();
+  }
+}
+
+template<typename T, size_t N>
+constexpr size_t SpscRing<T, N>::max_size()
+{
+  return N;
+}
+
+template<typename T, size_t N>
+T* SpscRing<T, N>::slot(const size_t index)
+{
+  return std::launder(reinterpret_cast<T*>(storage_[index % N]));
+}
+
+template<typename T, size_t N>
+template<typename U>
+bool SpscRing<T, N>::tryPushImpl(U&& value)
+{
+  const size_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail - cachedHead_ == N)
+  {
+    cachedHead_ = head_.load(std::memory_order_acquire);
+    if (tail - cachedHead_ == N)
+    {
+      return false;
+    }
+  }
+  new (storage_[tail % N]) T(std::forward<U>(value));
+  tail_.store(tail + 1, std::memory_order_release);
+  wake(consumerParked_);
+  return true;
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::try_push(T&& value)
+{
+  return tryPushImpl(std::move(value));
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::try_push(const T& value)
+{
+  return tryPushImpl(value);
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::push(T&& value)
+{
+  while (not closed())
+  {
+    if (try_push(std::move(value)))
+    {
+      return true;
+    }
+    wait(producerParked_, [this] {
+      return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire) < N;
+    });
+  }
+  return false;
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::try_pop(T& value)
+{
+  const size_t head = head_.load(std::memory_order_relaxed);
+  if (head == cachedTail_)
+  {
+    cachedTail_ = tail_.load(std::memory_order_acquire);
+    if (head == cachedTail_)
+    {
+      return false;
+    }
+  }
+  T* element = slot(head);
+  value = std::move(*element);
+  element->~T();
+  head_.store(head + 1, std::memory_order_release);
+  wake(producerParked_);
+  return true;
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::pop(T& value)
+{
+  while (true)
+  {
+    if (try_pop(value))
+    {
+      return true;
+    }
+    if (closed())
+    {
+      return try_pop(value); // an element may have been pushed right before closing
+    }
+    wait(consumerParked_, [this] {
+      return head_.load(std::memory_order_relaxed) != tail_.load(std::memory_order_acquire);
+    });
+  }
+}
+
+template<typename T, size_t N>
+void SpscRing<T, N>::close()
+{
+  closed_.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst); // closing is rare, so it never misses a parked side
+  wake(producerParked_);
+  wake(consumerParked_);
+}
+
+template<typename T, size_t N>
+bool SpscRing<T, N>::closed() const
+{
+  return closed_.load(std::memory_order_acquire);
+}
+
+template<typename T, size_t N>
+size_t SpscRing<T, N>::size() const
+{
+  return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+}
+
+template<typename T, size_t N>
+template<typename Ready>
+void SpscRing<T, N>::wait(std::atomic<bool>& parked, Ready ready)
+{
+  for (size_t i = 0; i < policy_.spinIterations; ++i)
+  {
+    if (ready() or closed())
+    {
+      return;
+    }
+  }
+  for (size_t i = 0; i < policy_.yieldIterations; ++i)
+  {
+    std::this_thread::yield();
+    if (ready() or closed())
+    {
+      return;
+    }
+  }
+
+  // the flag is raised before the final check, so that the other side either sees it and signals,
+  // or its update is seen by the check; the signalling side lowers the flag, which ends the wait
+  std::unique_lock<std::mutex> lock(parkMutex_);
+  parked.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (not ready() and not closed())
+  {
+    parkCondition_.wait_for(lock, policy_.parkTimeout, [&parked] { return not parked.load(); });
+  }
+  parked.store(false);
+}
+
+// the fast path only loads the flag and has no fence: without a full fence the load may still see a flag raised
+// a moment ago as lowered, and such a missed wake-up is bounded by the park timeout of the waiting side
+template<typename T, size_t N>
+void SpscRing<T, N>::wake(std::atomic<bool>& parked)
+{
+  if (parked.load(std::memory_order_relaxed) and parked.exchange(false))
+  {
+    std::lock_guard<std::mutex> lock(parkMutex_);
+    parkCondition_.notify_all();
+  }
+}
+
+#endif //CAMERA_FUSION_SPSCRING_HPP
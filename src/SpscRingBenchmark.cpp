@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// measures the throughput of handing elements over between two threads with SpscRing against a baseline of
+// a std::deque guarded by a mutex and condition variables; options:
+//   --items=N        no. of elements passed from the producer to the consumer (default: 1000000)
+//   --payload=B      size in bytes of the heap buffer every element owns and moves along, imitating
+//                    the images and point clouds of a DataFrame; 0 passes plain integers (default: 0)
+//   --runs=R         no. of repetitions; the best run of each variant is reported (default: 5)
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Options.hpp"
+#include "SpscRing.hpp"
+
+
+// capacity of the queues, a few frames as in the pipeline hand-offs
+constexpr size_t kCapacity = 8;
+
+struct Element
+{
+  uint64_t sequence = 0;
+  std::vector<unsigned char> payload;
+};
+
+// bounded queue the ring replaces
+class MutexQueue
+{
+public:
+
+  void push(Element&& element)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    notFull_.wait(lock, [this] { return queue_.size() < kCapacity; });
+    queue_.push_back(std::move(element));
+    notEmpty_.notify_one();
+  }
+
+  void pop(Element& element)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    notEmpty_.wait(lock, [this] { return not queue_.empty(); });
+    element = std::move(queue_.front());
+    queue_.pop_front();
+    notFull_.notify_one();
+  }
+
+private:
+
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+  std::deque<Element> queue_;
+};
+
+// runs the producer on a separate thread and the consumer on the calling one; returns the elements per second
+template <typename Queue>
+static double measureThroughput(Queue& queue, const size_t items, const size_t payloadBytes)
+{
+  const auto start = std::chrono::steady_clock::now();
+  std::thread producer([&queue, items, payloadBytes] {
+    for (size_t i = 0; i < items; ++i)
+    {
+      Element element;
+      element.sequence = i;
+      element.payload.resize(payloadBytes);
+      queue.push(std::move(element));
+    }
+  });
+
+  Element element;
+  for (size_t i = 0; i < items; ++i)
+  {
+    queue.pop(element);
+    if (element.sequence != i)
+    {
+      throw std::runtime_error("elements were reordered or lost");
+    }
+  }
+  producer.join();
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return static_cast<double>(items) / elapsed.count();
+}
+
+int main(int argc, const char* argv[])
+{
+  const auto options = ParseOptions(argc, argv, {"items", "payload", "runs"});
+  const size_t items = std::stoul(GetOption(options, "items", "1000000"));
+  const size_t payloadBytes = std::stoul(GetOption(options, "payload", "0"));
+  const size_t runs = std::stoul(GetOption(options, "runs", "5"));
+
+  double bestRing = 0.0, bestMutex = 0.0;
+  for (size_t run = 0; run < runs; ++run)
+  {
+    SpscRing<Element, kCapacity> ring;
+    bestRing = std::max(bestRing, measureThroughput(ring, items, payloadBytes));
+
+    MutexQueue mutexQueue;
+    bestMutex = std::max(bestMutex, measureThroughput(mutexQueue, items, payloadBytes));
+  }
+
+  std::cout << "items: " << items << ", payload: " << payloadBytes << " B, capacity: " << kCapacity << '\n'
+            << "SpscRing:        " << bestRing / 1e6 << " M elements/s\n"
+            << "mutex and deque: " << bestMutex / 1e6 << " M elements/s\n"
+            << "speed-up:        " << bestRing / bestMutex << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,373 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// stress test of SpscRing: millions of sequence-numbered, move-only elements owning heap buffers are handed over
+// between two threads with every combination of the non-blocking and the blocking operations, with the default
+// wait policy and with one parking the threads right away; the rings are also closed under parked threads and
+// destroyed with elements left in them; exits with 1 if any element is lost, reordered, corrupted or leaked, or
+// a parked thread is not woken up by close(); options:
+//   --items=N        no. of elements passed from the producer to the consumer in every hand-over (default: 2000000)
+//   --closes=C       no. of times a parked producer and a parked consumer are woken up by close() (default: 100)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Options.hpp"
+#include "SpscRing.hpp"
+
+
+// no. of words of the heap buffer of an element
+constexpr size_t kElementWords = 4;
+
+// a parked thread must be woken up by close() well before the park timeout expires
+constexpr std::chrono::seconds kCloseParkTimeout{10};
+constexpr std::chrono::seconds kMaxCloseLatency{2};
+
+// waits parking the thread right away, so that the parking and the wake-ups are exercised on every wait
+static SpscWaitPolicy parkingPolicy(const std::chrono::microseconds parkTimeout)
+{
+  SpscWaitPolicy policy;
+  policy.spinIterations = 0;
+  policy.yieldIterations = 0;
+  policy.parkTimeout = parkTimeout;
+  return policy;
+}
+
+// move-only element owning a heap buffer filled with its sequence number; the buffers alive are counted,
+// so that lost or doubly destroyed elements show up
+class Element
+{
+public:
+
+  Element() = default;
+
+  explicit Element(const uint64_t sequence) : words_{new uint64_t[kElementWords]}
+  {
+    for (size_t i = 0; i < kElementWords; ++i)
+    {
+      words_[i] = sequence;
+    }
+    ++alive_;
+  }
+
+  Element(Element&& other) noexcept : words_{std::move(other.words_)}
+  {
+
+  }
+
+  Element& operator=(Element&& other) noexcept
+  {
+    release();
+    words_ = std::move(other.words_);
+    return *this;
+  }
+
+  Element(const Element&) = delete;
+  Element& operator=(const Element&) = delete;
+
+  ~Element()
+  {
+    release();
+  }
+
+  // whether the element owns a buffer filled with the given sequence number
+  bool holds(const uint64_t sequence) const
+  {
+    if (not words_)
+    {
+      return false;
+    }
+    for (size_t i = 0; i < kElementWords; ++i)
+    {
+      if (words_[i] != sequence)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static long alive()
+  {
+    return alive_.load();
+  }
+
+private:
+
+  void release()
+  {
+    if (words_)
+    {
+      words_.reset();
+      --alive_;
+    }
+  }
+
+  std::unique_ptr<uint64_t[]> words_;
+  static std::atomic<long> alive_;
+};
+
+std::atomic<long> Element::alive_{0};
+
+enum class Side
+{
+  NON_BLOCKING,
+  BLOCKING
+};
+
+// hands the given no. of elements over from a producer thread to the calling thread; a blocking producer closes
+// the ring after the last element, and the consumer must still drain it; returns an error message or an empty one
+template <size_t N>
+static std::string handOver(const size_t items, const Side producerSide, const Side consumerSide,
+                            const SpscWaitPolicy policy)
+{
+  SpscRing<Element, N> ring(policy);
+  std::atomic<bool> producerFailed{false};
+
+  std::thread producer([&ring, &producerFailed, items, producerSide] {
+    for (size_t i = 0; i < items; ++i)
+    {
+      Element element(i);
+      if (producerSide == Side::BLOCKING)
+      {
+        if (not ring.push(std::move(element)))
+        {
+          producerFailed = true;
+          return;
+        }
+      }
+      else
+      {
+        while (not ring.try_push(std::move(element)))
+        {
+          std::this_thread::yield();
+        }
+      }
+    }
+    if (producerSide == Side::BLOCKING)
+    {
+      ring.close();
+    }
+  });
+
+  std::string error;
+  Element element;
+  size_t received = 0;
+  while (received < items)
+  {
+    if (consumerSide == Side::BLOCKING)
+    {
+      if (not ring.pop(element))
+      {
+        break;
+      }
+    }
+    else if (not ring.try_pop(element))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    if (not element.holds(received))
+    {
+      error = "element " + std::to_string(received) + " was reordered, lost or corrupted";
+      break;
+    }
+    ++received;
+  }
+  if (error.empty() and consumerSide == Side::BLOCKING and producerSide == Side::BLOCKING and ring.pop(element))
+  {
+    error = "an element was popped after the last one";
+  }
+  if (not error.empty())
+  {
+    ring.close(); // unblocks the producer
+  }
+  producer.join();
+
+  if (error.empty() and producerFailed)
+  {
+    error = "push failed on an open ring";
+  }
+  if (error.empty() and received != items)
+  {
+    error = "received " + std::to_string(received) + " of " + std::to_string(items) + " elements";
+  }
+  return error;
+}
+
+// closes the ring while the other side is parked in a blocking operation; returns an error message or an empty one
+template <typename Blocked>
+static std::string closeWhileParked(SpscRing<Element, 2>& ring, Blocked blocked, const bool expected)
+{
+  std::atomic<bool> result{not expected};
+  std::chrono::steady_clock::time_point returned;
+  std::thread side([&] {
+    result = blocked();
+    returned = std::chrono::steady_clock::now();
+  });
+
+  // gives the side the time to park; it waits for the park timeout unless close() wakes it up
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  const auto closing = std::chrono::steady_clock::now();
+  ring.close();
+  side.join();
+
+  if (result != expected)
+  {
+    return "the blocking operation returned " + std::string(result ? "true" : "false") + " on a closed ring";
+  }
+  if (returned - closing > kMaxCloseLatency)
+  {
+    return "close() did not wake up the parked thread";
+  }
+  return "";
+}
+
+static std::string closeParkedSides(const size_t closes)
+{
+  for (size_t i = 0; i < closes; ++i)
+  {
+    // consumer parked on an empty ring
+    {
+      SpscRing<Element, 2> ring(parkingPolicy(kCloseParkTimeout));
+      Element element;
+      std::string error = closeWhileParked(ring, [&ring, &element] { return ring.pop(element); }, false);
+      if (not error.empty())
+      {
+        return "consumer: " + error;
+      }
+    }
+
+    // producer parked on a full ring; the elements in it are still popped after close()
+    {
+      SpscRing<Element, 2> ring(parkingPolicy(kCloseParkTimeout));
+      ring.try_push(Element(0));
+      ring.try_push(Element(1));
+      Element blockedElement(2);
+      std::string error = closeWhileParked(ring, [&ring, &blockedElement] {
+        return ring.push(std::move(blockedElement));
+      }, false);
+      if (not error.empty())
+      {
+        return "producer: " + error;
+      }
+      if (not blockedElement.holds(2))
+      {
+        return "producer: the element of a failed push was moved from";
+      }
+      Element element;
+      if (not ring.pop(element) or not element.holds(0) or not ring.pop(element) or not element.holds(1))
+      {
+        return "the elements pushed before close() were not drained";
+      }
+      if (ring.pop(element) or ring.try_pop(element))
+      {
+        return "an element was popped from a drained closed ring";
+      }
+    }
+  }
+  return "";
+}
+
+// destroys rings holding elements, including ones wrapped around the end of the storage
+static std::string destroyNonEmpty()
+{
+  for (size_t popped = 0; popped < 8; ++popped)
+  {
+    for (size_t left = 0; left <= 5; ++left)
+    {
+      SpscRing<Element, 5> ring;
+      Element element;
+      for (size_t i = 0; i < popped; ++i)
+      {
+        ring.try_push(Element(i));
+        ring.try_pop(element);
+      }
+      for (size_t i = 0; i < left; ++i)
+      {
+        if (not ring.try_push(Element(i)))
+        {
+          return "try_push failed on a ring with room";
+        }
+      }
+      if (ring.try_push(Element(left)) == (left == 5))
+      {
+        return "try_push ignored the capacity";
+      }
+      if (ring.size() != std::min<size_t>(left + 1, 5))
+      {
+        return "size() does not count the elements";
+      }
+    }
+    if (Element::alive() != 0)
+    {
+      return std::to_string(Element::alive()) + " elements leaked by the destructor";
+    }
+  }
+  return "";
+}
+
+int main(int argc, const char* argv[])
+{
+  const auto options = ParseOptions(argc, argv, {"items", "closes"});
+  const size_t items = std::stoul(GetOption(options, "items", "2000000"));
+  const size_t closes = std::stoul(GetOption(options, "closes", "100"));
+
+  const SpscWaitPolicy defaultPolicy;
+  const SpscWaitPolicy parking = parkingPolicy(std::chrono::milliseconds(100));
+  const std::vector<std::pair<std::string, std::function<std::string()>>> cases = {
+      {"try_push/try_pop", [&] { return handOver<8>(items, Side::NON_BLOCKING, Side::NON_BLOCKING, defaultPolicy); }},
+      {"push/pop", [&] { return handOver<8>(items, Side::BLOCKING, Side::BLOCKING, defaultPolicy); }},
+      {"push/try_pop", [&] { return handOver<8>(items, Side::BLOCKING, Side::NON_BLOCKING, defaultPolicy); }},
+      {"try_push/pop", [&] { return handOver<8>(items, Side::NON_BLOCKING, Side::BLOCKING, defaultPolicy); }},
+      {"push/pop, capacity 1", [&] { return handOver<1>(items / 8, Side::BLOCKING, Side::BLOCKING, defaultPolicy); }},
+      {"push/pop, parking", [&] { return handOver<8>(items / 4, Side::BLOCKING, Side::BLOCKING, parking); }},
+      {"close() while parked", [&] { return closeParkedSides(closes); }},
+      {"destruction with elements left", [] { return destroyNonEmpty(); }},
+  };
+
+  size_t failures = 0;
+  for (const auto& testCase : cases)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    std::string error = testCase.second();
+    if (error.empty() and Element::alive() != 0)
+    {
+      error = std::to_string(Element::alive()) + " elements leaked";
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << testCase.first << ": " << (error.empty() ? "passed" : "FAILED, " + error)
+              << " (" << elapsed.count() << " s)" << std::endl;
+    failures += error.empty() ? 0 : 1;
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
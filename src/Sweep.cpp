@@ -0,0 +1,319 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Sweep.hpp"
+
+
+static std::string hostName()
+{
+  char name[256] = {};
+  ::gethostname(name, sizeof(name) - 1);
+  return name;
+}
+
+static bool fileExists(const std::string& path)
+{
+  struct stat st{};
+  return ::stat(path.c_str(), &st) == 0;
+}
+
+
+SweepQueue::SweepQueue(std::string directory) : directory_{std::move(directory)}
+{
+  if (::mkdir(directory_.c_str(), 0777) != 0 and errno != EEXIST)
+  {
+    throw std::runtime_error("cannot create the sweep directory " + directory_ + ": " + std::strerror(errno));
+  }
+}
+
+size_t SweepQueue::releaseStaleClaims() const
+{
+  const std::string claimExtension = ".claim";
+  const std::string host = hostName();
+
+  DIR* dir = ::opendir(directory_.c_str());
+  if (dir == nullptr)
+  {
+    throw std::runtime_error("cannot read the sweep directory " + directory_ + ": " + std::strerror(errno));
+  }
+
+  std::vector<std::string> staleNames;
+  while (const dirent* entry = ::readdir(dir))
+  {
+    const std::string file{entry->d_name};
+    if (file.size() <= claimExtension.size() or
+        file.compare(file.size() - claimExtension.size(), claimExtension.size(), claimExtension) != 0)
+    {
+      continue;
+    }
+    const std::string name = file.substr(0, file.size() - claimExtension.size());
+    if (isComplete(name))
+    {
+      continue;
+    }
+
+    // the claims of the other hosts cannot be checked; they are left to the coordinators running there
+    std::ifstream claimFile(path(name, claimExtension));
+    std::string claimHost;
+    pid_t claimPid = 0;
+    if (claimFile >> claimHost >> claimPid and claimHost == host and
+        ::kill(claimPid, 0) != 0 and errno == ESRCH)
+    {
+      staleNames.push_back(name);
+    }
+  }
+  ::closedir(dir);
+
+  for (const auto& name : staleNames)
+  {
+    ::unlink(partialResultPath(name).c_str());
+    ::unlink(path(name, claimExtension).c_str());
+  }
+  return staleNames.size();
+}
+
+bool SweepQueue::claim(const std::string& name) const
+{
+  if (isComplete(name))
+  {
+    return false;
+  }
+
+  // O_EXCL makes the creation atomic: exactly one process succeeds
+  const int fd = ::open(path(name, ".claim").c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+  if (fd < 0)
+  {
+    if (errno == EEXIST)
+    {
+      return false;
+    }
+    throw std::runtime_error("cannot claim " + name + ": " + std::strerror(errno));
+  }
+
+  const std::string owner = hostName() + ' ' + std::to_string(::getpid()) + '\n';
+  const bool written = ::write(fd, owner.data(), owner.size()) == static_cast<ssize_t>(owner.size());
+  ::close(fd);
+  if (not written)
+  {
+    throw std::runtime_error("cannot record the claim of " + name);
+  }
+  return true;
+}
+
+std::string SweepQueue::partialResultPath(const std::string& name) const
+{
+  return path(name, ".txt.part");
+}
+
+void SweepQueue::complete(const std::string& name) const
+{
+  if (::rename(partialResultPath(name).c_str(), path(name, ".txt").c_str()) != 0)
+  {
+    throw std::runtime_error("cannot store the results of " + name + ": " + std::strerror(errno));
+  }
+
+  const int fd = ::open(path(name, ".done").c_str(), O_WRONLY | O_CREAT, 0666);
+  if (fd < 0)
+  {
+    throw std::runtime_error("cannot mark " + name + " as complete: " + std::strerror(errno));
+  }
+  ::close(fd);
+}
+
+bool SweepQueue::isComplete(const std::string& name) const
+{
+  return fileExists(path(name, ".done"));
+}
+
+size_t SweepQueue::merge(const std::vector<std::string>& names) const
+{
+  std::ofstream merged(directory_ + "/sweep_results.txt");
+  bool bHeaderWritten = false;
+  size_t incomplete = 0;
+  for (const auto& name : names)
+  {
+    if (not isComplete(name))
+    {
+      ++incomplete;
+      continue;
+    }
+
+    std::ifstream results(path(name, ".txt"));
+    std::string line;
+    if (std::getline(results, line) and not bHeaderWritten)
+    {
+      merged << "config " << line << '\n';
+      bHeaderWritten = true;
+    }
+    while (std::getline(results, line))
+    {
+      merged << name << ' ' << line << '\n';
+    }
+  }
+
+  return incomplete;
+}
+
+std::string SweepQueue::path(const std::string& name, const std::string& extension) const
+{
+  return directory_ + '/' + name + extension;
+}
+
+
+bool ForkSweepWorkers(const size_t workers, size_t* const workerIndex)
+{
+  // otherwise the output buffered so far would be written once by every process
+  std::cout.flush();
+  std::fflush(nullptr);
+
+  std::vector<pid_t> pids;
+  for (size_t i = 0; i < workers; ++i)
+  {
+    const pid_t pid = ::fork();
+    if (pid == 0)
+    {
+      if (workerIndex)
+      {
+        *workerIndex = i;
+      }
+      return true;
+    }
+    if (pid < 0)
+    {
+      std::cerr << "cannot start a sweep worker: " << std::strerror(errno) << std::endl;
+      break;
+    }
+    pids.push_back(pid);
+  }
+
+  for (const auto pid : pids)
+  {
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 and errno == EINTR)
+    {
+    }
+    if (not WIFEXITED(status) or WEXITSTATUS(status) != 0)
+    {
+      std::cerr << "sweep worker " << pid << " has failed; its claim is released on the next run" << std::endl;
+    }
+  }
+  return false;
+}
+
+
+void SweepScore::addFrame(const double processingMs)
+{
+  ++frames_;
+  processingMs_ += processingMs;
+}
+
+void SweepScore::addMeasurement(const double ttcLidar, const double ttcCamera)
+{
+  if (not std::isfinite(ttcLidar) or ttcLidar == 0.0)
+  {
+    return;
+  }
+
+  ++measurements_;
+  deviations_ += std::isfinite(ttcCamera) ? std::min(std::abs(ttcCamera - ttcLidar) / std::abs(ttcLidar), 1.0) : 1.0;
+}
+
+double SweepScore::disagreement() const
+{
+  return measurements_ > 0 ? deviations_ / static_cast<double>(measurements_) : 1.0;
+}
+
+double SweepScore::msPerFrame() const
+{
+  return frames_ > 0 ? processingMs_ / static_cast<double>(frames_) : 0.0;
+}
+
+double SweepScore::score(const double latencyWeight) const
+{
+  return disagreement() + latencyWeight * msPerFrame() / 100.0;
+}
+
+std::vector<size_t> SelectHalvingSurvivors(const std::vector<SweepScore>& scores, const double keepFraction,
+                                           const double latencyWeight)
+{
+  if (keepFraction <= 0.0 or keepFraction > 1.0)
+  {
+    throw std::invalid_argument("the fraction of the combinations kept must be in (0, 1]");
+  }
+
+  std::vector<size_t> ranking(scores.size());
+  for (size_t i = 0; i < ranking.size(); ++i)
+  {
+    ranking[i] = i;
+  }
+  std::stable_sort(ranking.begin(), ranking.end(), [&scores, latencyWeight](const size_t lhs, const size_t rhs) {
+    return scores[lhs].score(latencyWeight) < scores[rhs].score(latencyWeight);
+  });
+
+  const auto kept = static_cast<size_t>(std::ceil(keepFraction * static_cast<double>(scores.size())));
+  std::vector<bool> survives(scores.size(), false);
+  for (size_t rank = 0; rank < std::min(std::max<size_t>(kept, 1), ranking.size()); ++rank)
+  {
+    survives[ranking[rank]] = true;
+  }
+
+  // a combination no other one is at least as good as in both respects, and better in one, is never dropped
+  for (size_t i = 0; i < scores.size(); ++i)
+  {
+    bool dominated = false;
+    for (size_t j = 0; j < scores.size() and not dominated; ++j)
+    {
+      dominated = scores[j].disagreement() <= scores[i].disagreement() and
+                  scores[j].msPerFrame() <= scores[i].msPerFrame() and
+                  (scores[j].disagreement() < scores[i].disagreement() or
+                   scores[j].msPerFrame() < scores[i].msPerFrame());
+    }
+    survives[i] = survives[i] or not dominated;
+  }
+
+  std::vector<size_t> survivors;
+  for (size_t i = 0; i < scores.size(); ++i)
+  {
+    if (survives[i])
+    {
+      survivors.push_back(i);
+    }
+  }
+  return survivors;
+}
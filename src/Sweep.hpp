@@ -0,0 +1,110 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_SWEEP_HPP
+#define CAMERA_FUSION_SWEEP_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+// work queue of a configuration sweep shared by processes through a directory, which may reside on a file system
+// shared by several nodes: a combination is claimed by exclusively creating <dir>/<name>.claim, its results are
+// written to <dir>/<name>.txt, and <dir>/<name>.done marks it as complete, so that an interrupted sweep resumes
+// with the combinations which are not done yet
+class SweepQueue
+{
+public:
+
+  explicit SweepQueue(std::string directory);
+
+  // removes the claims of the unfinished combinations left behind by the processes of this host which no longer
+  // exist, so that those combinations are run again; returns the number of claims removed
+  size_t releaseStaleClaims() const;
+
+  // returns true if the combination has been claimed by the calling process, false if it is claimed by another
+  // process or is already complete
+  bool claim(const std::string& name) const;
+
+  // path the results of a claimed combination are to be written to; the results become visible under
+  // <dir>/<name>.txt only once the combination is complete
+  std::string partialResultPath(const std::string& name) const;
+
+  // marks the claimed combination as complete
+  void complete(const std::string& name) const;
+
+  bool isComplete(const std::string& name) const;
+
+  // concatenates the results of the complete combinations into <dir>/sweep_results.txt, every line prefixed with
+  // the name of its combination; returns the number of the combinations which are not complete
+  size_t merge(const std::vector<std::string>& names) const;
+
+private:
+
+  std::string path(const std::string& name, const std::string& extension) const;
+
+  const std::string directory_;
+};
+
+// forks the given number of worker processes; returns true in the workers, which are expected to process the queue
+// and exit, and false in the calling process once all the workers have exited; the workers are numbered from 0,
+// and a worker finds its number in workerIndex, if given
+bool ForkSweepWorkers(size_t workers, size_t* workerIndex = nullptr);
+
+// quality and cost of a combination measured on the frames of a round of the successive-halving sweep: the
+// disagreement of the Camera TTC with the Lidar TTC, which serves as the reference, and the processing time
+class SweepScore
+{
+public:
+
+  // accounts for a processed frame taking the given time, without the loading
+  void addFrame(double processingMs);
+
+  // accounts for the TTC of a track; the measurements without a finite Lidar TTC have no reference and are ignored
+  void addMeasurement(double ttcLidar, double ttcCamera);
+
+  // mean deviation of the Camera TTC relative to the Lidar TTC, capped at 1, which is also the deviation of an
+  // undefined or infinite Camera TTC; 1 if there is no measurement at all
+  double disagreement() const;
+
+  double msPerFrame() const;
+
+  // the lower the better: disagreement() + latencyWeight * msPerFrame() / 100, so that latencyWeight is the cost
+  // of 100 ms per frame in units of the relative TTC deviation
+  double score(double latencyWeight) const;
+
+private:
+
+  size_t frames_ = 0;
+  double processingMs_ = 0.0;
+  size_t measurements_ = 0;
+  double deviations_ = 0.0;
+};
+
+// indices of the combinations promoted to the next round: the best keepFraction of them by the score (at least one),
+// and all the combinations on the Pareto front of the disagreement and the time per frame, in ascending order
+std::vector<size_t> SelectHalvingSurvivors(const std::vector<SweepScore>& scores, double keepFraction,
+                                           double latencyWeight);
+
+#endif //CAMERA_FUSION_SWEEP_HPP
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <opencv2/core.hpp>
+
+#include "ThreadBudget.hpp"
+
+
+// the cores in the affinity mask of the process, e.g., as restricted by taskset or a container
+static std::vector<int> availableCpus()
+{
+  std::vector<int> cpus;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (::sched_getaffinity(0, sizeof(mask), &mask) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &mask))
+      {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  if (cpus.empty())
+  {
+    for (int cpu = 0; cpu < std::max(1, cv::getNumberOfCPUs()); ++cpu)
+    {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+ThreadBudget::ThreadBudget(const size_t workers, const bool pinThreads)
+  : cpus_{availableCpus()}, workerCpus_(workers), pinThreads_{pinThreads}
+{
+  if (workers == 0)
+  {
+    throw std::invalid_argument("the thread budget needs at least one worker");
+  }
+
+  // contiguous shares of equal size; with more workers than cores, the workers share the cores round-robin
+  const size_t share = std::max<size_t>(1, cpus_.size() / workers);
+  for (size_t worker = 0; worker < workers; ++worker)
+  {
+    for (size_t i = 0; i < share; ++i)
+    {
+      workerCpus_[worker].push_back(cpus_[(worker * share + i) % cpus_.size()]);
+    }
+  }
+  opencvThreads_ = static_cast<int>(share);
+}
+
+void ThreadBudget::applyToProcess() const
+{
+  cv::setNumThreads(opencvThreads_);
+  cv::parallel_for_(cv::Range(0, opencvThreads_), [](const cv::Range&) {});
+}
+
+void ThreadBudget::enterWorker(const size_t worker) const
+{
+  if (not pinThreads_)
+  {
+    return;
+  }
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (const int cpu : workerCpus_.at(worker))
+  {
+    CPU_SET(cpu, &mask);
+  }
+  const int error = ::pthread_setaffinity_np(::pthread_self(), sizeof(mask), &mask);
+  if (error != 0)
+  {
+    throw std::runtime_error(std::string("cannot pin the worker to its cores: ") + std::strerror(error));
+  }
+}
+
+std::string ThreadBudget::describe() const
+{
+  std::ostringstream oss;
+  oss << cores() << " cores, " << workers() << (workers() == 1 ? " worker x " : " workers x ")
+      << opencvThreads_ << " OpenCV thread" << (opencvThreads_ == 1 ? "" : "s");
+  if (pinThreads_)
+  {
+    oss << ", pinned to ";
+    for (size_t worker = 0; worker < workerCpus_.size(); ++worker)
+    {
+      oss << (worker ? " | " : "");
+      for (size_t i = 0; i < workerCpus_[worker].size(); ++i)
+      {
+        oss << (i ? "," : "") << workerCpus_[worker][i];
+      }
+    }
+  }
+  return oss.str();
+}
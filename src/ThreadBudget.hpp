@@ -0,0 +1,69 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_THREADBUDGET_HPP
+#define CAMERA_FUSION_THREADBUDGET_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+// divides the cores the process may run on between the pipeline workers (sequence threads or sweep processes),
+// so that the workers and OpenCV's internal parallelism (DNN, goodFeaturesToTrack, cornerHarris, the matchers)
+// do not oversubscribe the machine; every worker gets a disjoint share of the cores, and OpenCV gets as many
+// threads as the share has cores
+class ThreadBudget
+{
+public:
+
+  // if pinThreads is set, every worker is pinned to the cores of its share
+  ThreadBudget(size_t workers, bool pinThreads);
+
+  size_t cores() const { return cpus_.size(); }
+  size_t workers() const { return workerCpus_.size(); }
+
+  // no. of threads of OpenCV's internal parallelism per worker
+  int opencvThreads() const { return opencvThreads_; }
+
+  // limits OpenCV's thread pool of the calling process; the setting is process-wide (OpenCV has no per-thread
+  // limit), hence workers sharing a process share the setting too; the pool is started by this call, so that
+  // its threads inherit the affinity of the calling thread, not that of some pinned worker thread
+  void applyToProcess() const;
+
+  // pins the calling thread, and the threads it starts later, to the cores of the worker; does nothing
+  // unless pinning is enabled; throws std::runtime_error if the affinity cannot be set
+  void enterWorker(size_t worker) const;
+
+  // the configuration, e.g., "8 cores, 4 workers x 2 OpenCV threads, pinned to 0,1 | 2,3 | 4,5 | 6,7"
+  std::string describe() const;
+
+private:
+
+  std::vector<int> cpus_;                    // the cores the process may run on
+  std::vector<std::vector<int>> workerCpus_; // the share of every worker
+  int opencvThreads_;
+  bool pinThreads_;
+};
+
+#endif //CAMERA_FUSION_THREADBUDGET_HPP
@@ -0,0 +1,197 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TrackManager.hpp"
+
+
+void RunningStatistics::add(const double value)
+{
+  ++count;
+  const double delta = value - mean;
+  mean += delta / static_cast<double>(count);
+  m2 += delta * (value - mean);
+}
+
+double RunningStatistics::variance() const
+{
+  return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0;
+}
+
+// builds a lookup table from box IDs to the indices of the boxes in the given list; box IDs are small
+// non-negative integers (usually equal to the indices themselves), so a dense table suffices
+static void indexBoxIDs(const std::vector<BoundingBox>& boxes, std::vector<int>& indexOfID)
+{
+  indexOfID.clear();
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    const auto boxID = static_cast<size_t>(boxes[i].boxID);
+    if (boxID >= indexOfID.size())
+    {
+      indexOfID.resize(boxID + 1, -1);
+    }
+    indexOfID[boxID] = static_cast<int>(i);
+  }
+}
+
+static int lookupBoxIndex(const std::vector<int>& indexOfID, const int boxID)
+{
+  return boxID >= 0 and static_cast<size_t>(boxID) < indexOfID.size() ? indexOfID[boxID] : -1;
+}
+
+void TrackManager::update(const DataFrame* const prevFrame, DataFrame& currFrame)
+{
+  // the boxes of the current frame become the boxes of the previous frame; the tracks which have had no box
+  // in the current frame cannot be continued any more
+  for (size_t slot = 0; slot < tracks_.size(); ++slot)
+  {
+    Track& track = tracks_[slot];
+    if (track.trackID < 0)
+    {
+      continue;
+    }
+    if (track.currBoxIndex < 0)
+    {
+      retireTrack(slot);
+      continue;
+    }
+    track.prevBoxIndex = track.currBoxIndex;
+    track.currBoxIndex = -1;
+  }
+  matchedTracks_.clear();
+
+  for (auto& box : currFrame.boundingBoxes)
+  {
+    box.trackID = -1;
+  }
+
+  if (prevFrame != nullptr)
+  {
+    indexBoxIDs(prevFrame->boundingBoxes, prevIndexOfID_);
+    indexBoxIDs(currFrame.boundingBoxes, currIndexOfID_);
+
+    for (const auto& bbMatch : currFrame.bbMatches)
+    {
+      const int prevIndex = lookupBoxIndex(prevIndexOfID_, bbMatch.first);
+      const int currIndex = lookupBoxIndex(currIndexOfID_, bbMatch.second);
+      if (prevIndex < 0 or currIndex < 0)
+      {
+        continue;
+      }
+
+      const int trackID = prevFrame->boundingBoxes[prevIndex].trackID;
+      BoundingBox& currBox = currFrame.boundingBoxes[currIndex];
+      const auto slot = slotOfID_.find(trackID);
+      if (slot == slotOfID_.end() or currBox.trackID >= 0)
+      {
+        continue;
+      }
+
+      // a box continues at most one track, and a track continues into at most one box
+      Track& track = tracks_[slot->second];
+      if (track.currBoxIndex >= 0 or track.prevBoxIndex != prevIndex)
+      {
+        continue;
+      }
+
+      currBox.trackID = trackID;
+      track.currBoxIndex = currIndex;
+      ++track.age;
+      matchedTracks_.push_back(trackID);
+    }
+  }
+
+  // unmatched boxes start new tracks
+  for (size_t i = 0; i < currFrame.boundingBoxes.size(); ++i)
+  {
+    BoundingBox& box = currFrame.boundingBoxes[i];
+    if (box.trackID < 0)
+    {
+      box.trackID = createTrack();
+      Track& track = this->track(box.trackID);
+      track.currBoxIndex = static_cast<int>(i);
+      track.age = 1;
+    }
+  }
+}
+
+int TrackManager::createTrack()
+{
+  size_t slot = tracks_.size();
+  if (freeSlots_.empty())
+  {
+    tracks_.emplace_back();
+  }
+  else
+  {
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    tracks_[slot] = Track();
+  }
+
+  tracks_[slot].trackID = nextTrackID_++;
+  slotOfID_[tracks_[slot].trackID] = slot;
+  return tracks_[slot].trackID;
+}
+
+void TrackManager::retireTrack(const size_t slot)
+{
+  slotOfID_.erase(tracks_[slot].trackID);
+  tracks_[slot].trackID = -1;
+  freeSlots_.push_back(slot);
+}
+
+const std::vector<int>& TrackManager::matchedTracks() const
+{
+  return matchedTracks_;
+}
+
+Track& TrackManager::track(const int trackID)
+{
+  return tracks_[slotOfID_.at(trackID)];
+}
+
+BoundingBox* TrackManager::prevBox(const int trackID, DataFrame& prevFrame)
+{
+  const int index = track(trackID).prevBoxIndex;
+  return index < 0 ? nullptr : &prevFrame.boundingBoxes[index];
+}
+
+BoundingBox* TrackManager::currBox(const int trackID, DataFrame& currFrame)
+{
+  const int index = track(trackID).currBoxIndex;
+  return index < 0 ? nullptr : &currFrame.boundingBoxes[index];
+}
+
+void TrackManager::record(const int trackID, const int frameIndex, const double ttcLidar, const double ttcCamera)
+{
+  Track& track = this->track(trackID);
+
+  TrackRecord record;
+  record.frameIndex = frameIndex;
+  record.ttcLidar = ttcLidar;
+  record.ttcCamera = ttcCamera;
+  track.history.push_back(record);
+
+  track.ttcLidarStats.add(ttcLidar);
+  track.ttcCameraStats.add(ttcCamera);
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_TRACKMANAGER_HPP
+#define CAMERA_FUSION_TRACKMANAGER_HPP
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "CircularBuffer.hpp"
+#include "TtcFilter.hpp"
+#include "dataStructures.h"
+
+
+// mean and variance of a series of values updated incrementally (Welford's algorithm)
+struct RunningStatistics
+{
+  size_t count = 0;
+  double mean = 0.0;
+  double m2 = 0.0; // sum of squared deviations from the mean
+
+  void add(double value);
+  double variance() const;
+};
+
+// measurements of a track taken at a single frame
+struct TrackRecord
+{
+  int frameIndex = -1;
+  double ttcLidar = 0.0;
+  double ttcCamera = 0.0;
+};
+
+// state of an object tracked across frames
+struct Track
+{
+  static constexpr size_t kHistorySize = 16; // no. of the latest per-frame records kept for each track
+
+  int trackID = -1;
+  int prevBoxIndex = -1; // index of the track's box in the previous frame's boundingBoxes, -1 if absent
+  int currBoxIndex = -1; // index of the track's box in the current frame's boundingBoxes, -1 if absent
+  size_t age = 0;        // no. of frames in which the track has been observed
+
+  CircularBuffer<TrackRecord, kHistorySize> history; // bounded history of the latest records
+  RunningStatistics ttcLidarStats;  // statistics over the whole life of the track
+  RunningStatistics ttcCameraStats; //
+
+  TtcFilter ttcFilter; // fusion of the Lidar and Camera measurements of the track
+  int filterFrameIndex = -1; // frame of the latest update of ttcFilter, -1 if it has not been started
+};
+
+// assigns persistent track IDs to the bounding boxes of consecutive frames based on their bounding box matches;
+// the tracks are kept in a dense table of slots, so that the boxes of a track in the previous and the current
+// frames are accessible in constant time; a track which has no box in the current frame cannot be continued,
+// so it is retired on the next update and its slot is reused, which bounds the table by the no. of boxes
+// of two consecutive frames; track IDs are never reused
+class TrackManager
+{
+public:
+
+  // assigns track IDs to the bounding boxes of the current frame; the boxes matched (DataFrame::bbMatches) to
+  // the boxes of the previous frame continue their tracks, all the others start new tracks;
+  // prevFrame is nullptr for the first frame of a sequence
+  void update(const DataFrame* prevFrame, DataFrame& currFrame);
+
+  // IDs of the tracks which have boxes in both the previous and the current frames
+  const std::vector<int>& matchedTracks() const;
+
+  // the tracks having a box in the previous or the current frame are accessible
+  Track& track(int trackID);
+
+  // bounding boxes of the track in the previous and the current frames, nullptr if absent
+  BoundingBox* prevBox(int trackID, DataFrame& prevFrame);
+  BoundingBox* currBox(int trackID, DataFrame& currFrame);
+
+  // appends the TTC estimates of the current frame to the track's history and statistics
+  void record(int trackID, int frameIndex, double ttcLidar, double ttcCamera);
+
+private:
+
+  int createTrack();
+  void retireTrack(size_t slot);
+
+  std::vector<Track> tracks_;      // dense table of tracks, the free slots have the track ID -1
+  std::vector<size_t> freeSlots_;  // slots of the retired tracks
+  std::unordered_map<int, size_t> slotOfID_; // slot of each live track
+  int nextTrackID_ = 0;
+  std::vector<int> matchedTracks_; // tracks present in both the previous and the current frames
+  std::vector<int> prevIndexOfID_; // previous frame's box index for each box ID, -1 if there is no such box
+  std::vector<int> currIndexOfID_; // current frame's box index for each box ID, -1 if there is no such box
+};
+
+#endif //CAMERA_FUSION_TRACKMANAGER_HPP
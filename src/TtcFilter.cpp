@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <limits>
+
+#include "TtcFilter.hpp"
+
+
+// state vector layout: [distance, range-rate, range acceleration]
+constexpr int kStateSize = 3;
+constexpr int kRangeIndex = 0;
+constexpr int kRangeRateIndex = 1;
+
+// initial standard deviations of the range-rate and the range acceleration, when they are unknown
+constexpr double kInitialRangeRateStd = 5.0;    // [m/s]
+constexpr double kInitialAccelerationStd = 5.0; // [m/s^2]
+
+TtcFilter::TtcFilter(const double jerkSpectralDensity)
+  : kf_{kStateSize, 1, 0, CV_64F}, jerkSpectralDensity_{jerkSpectralDensity}, initialized_{false}
+{
+
+}
+
+bool TtcFilter::initialized() const
+{
+  return initialized_;
+}
+
+void TtcFilter::init(const double range, const double rangeVariance, const double ttcLidar)
+{
+  const bool bKnownRangeRate = std::isfinite(ttcLidar) and std::abs(ttcLidar) > 0.0;
+
+  kf_.statePost = cv::Mat::zeros(kStateSize, 1, CV_64F);
+  kf_.statePost.at<double>(kRangeIndex) = range;
+  kf_.statePost.at<double>(kRangeRateIndex) = bKnownRangeRate ? -range / ttcLidar : 0.0;
+
+  kf_.errorCovPost = cv::Mat::zeros(kStateSize, kStateSize, CV_64F);
+  kf_.errorCovPost.at<double>(0, 0) = rangeVariance;
+  kf_.errorCovPost.at<double>(1, 1) = kInitialRangeRateStd * kInitialRangeRateStd;
+  kf_.errorCovPost.at<double>(2, 2) = kInitialAccelerationStd * kInitialAccelerationStd;
+
+  initialized_ = true;
+}
+
+void TtcFilter::predict(const double dt)
+{
+  const double dt2 = dt * dt;
+  const double dt3 = dt2 * dt;
+
+  kf_.transitionMatrix = cv::Mat::eye(kStateSize, kStateSize, CV_64F);
+  kf_.transitionMatrix.at<double>(0, 1) = dt;
+  kf_.transitionMatrix.at<double>(0, 2) = dt2 / 2.0;
+  kf_.transitionMatrix.at<double>(1, 2) = dt;
+
+  // process noise of the discretized continuous white jerk model
+  const double q = jerkSpectralDensity_;
+  cv::Mat& Q = kf_.processNoiseCov;
+  Q = cv::Mat(kStateSize, kStateSize, CV_64F);
+  Q.at<double>(0, 0) = q * dt3 * dt2 / 20.0;
+  Q.at<double>(0, 1) = Q.at<double>(1, 0) = q * dt2 * dt2 / 8.0;
+  Q.at<double>(0, 2) = Q.at<double>(2, 0) = q * dt3 / 6.0;
+  Q.at<double>(1, 1) = q * dt3 / 3.0;
+  Q.at<double>(1, 2) = Q.at<double>(2, 1) = q * dt2 / 2.0;
+  Q.at<double>(2, 2) = q * dt;
+
+  // the prediction also becomes the posterior, in case no measurement arrives before the next cycle
+  kf_.predict();
+}
+
+void TtcFilter::correct(const int stateIndex, const double measurement, const double variance)
+{
+  kf_.measurementMatrix = cv::Mat::zeros(1, kStateSize, CV_64F);
+  kf_.measurementMatrix.at<double>(0, stateIndex) = 1.0;
+  kf_.measurementNoiseCov = cv::Mat(1, 1, CV_64F, cv::Scalar(variance));
+
+  // cv::KalmanFilter::correct() updates the prior; the posterior of a preceding correction of the same cycle
+  // becomes the prior of this one, so that the Lidar and Camera measurements can be incorporated one by one
+  kf_.statePost.copyTo(kf_.statePre);
+  kf_.errorCovPost.copyTo(kf_.errorCovPre);
+  kf_.correct(cv::Mat(1, 1, CV_64F, cv::Scalar(measurement)));
+}
+
+void TtcFilter::correctRange(const double range, const double rangeVariance)
+{
+  correct(kRangeIndex, range, rangeVariance);
+}
+
+void TtcFilter::correctTTC(const double ttc, const double ttcVariance)
+{
+  // v = -d / TTC; the relative uncertainty of the TTC carries over to the range-rate
+  const double rangeRate = -range() / ttc;
+  const double rangeRateVariance = rangeRate * rangeRate * ttcVariance / (ttc * ttc);
+  correct(kRangeRateIndex, rangeRate, rangeRateVariance);
+}
+
+double TtcFilter::range() const
+{
+  return kf_.statePost.at<double>(kRangeIndex);
+}
+
+double TtcFilter::rangeRate() const
+{
+  return kf_.statePost.at<double>(kRangeRateIndex);
+}
+
+double TtcFilter::ttc() const
+{
+  return rangeRate() < 0.0 ? -range() / rangeRate() : std::numeric_limits<double>::infinity();
+}
@@ -0,0 +1,70 @@
+/**
+ * Copyright (C) 2019  Sergey Morozov <sergey@morozov.ch>
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, 
+ * publish, distribute, sublicense, and/or sell copies of the Software, 
+ * and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH 
+ * THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAMERA_FUSION_TTCFILTER_HPP
+#define CAMERA_FUSION_TTCFILTER_HPP
+
+#include <opencv2/video/tracking.hpp>
+
+
+// constant-acceleration Kalman filter over the distance to an object ahead, the range-rate and the range
+// acceleration; fuses the Lidar-derived distances with the Camera-derived TTC estimates,
+// each weighted by its own uncertainty, into a single TTC estimate
+class TtcFilter
+{
+public:
+
+  // jerkSpectralDensity is the power spectral density of the white jerk noise driving the motion model
+  explicit TtcFilter(double jerkSpectralDensity = 1.0);
+
+  bool initialized() const;
+
+  // starts the filter from a Lidar measurement of the distance and the Lidar-derived TTC, if the latter is finite
+  void init(double range, double rangeVariance, double ttcLidar);
+
+  // propagates the state dt seconds ahead
+  void predict(double dt);
+
+  // incorporates a Lidar measurement of the distance to the object
+  void correctRange(double range, double rangeVariance);
+
+  // incorporates a Camera-derived TTC measurement; with the distance known from the state,
+  // the TTC translates into a measurement of the range-rate
+  void correctTTC(double ttc, double ttcVariance);
+
+  double range() const;
+  double rangeRate() const;
+
+  // time-to-collision derived from the state; infinity if the object is not approaching
+  double ttc() const;
+
+private:
+
+  void correct(int stateIndex, double measurement, double variance);
+
+  cv::KalmanFilter kf_;
+  double jerkSpectralDensity_;
+  bool initialized_;
+};
+
+#endif //CAMERA_FUSION_TTCFILTER_HPP
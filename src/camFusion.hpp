@@ -6,16 +6,60 @@
 #include <vector>
 #include <opencv2/core.hpp>
 #include "dataStructures.h"
+#include "LidarIndex.hpp"
 
 
-void clusterLidarWithROI(std::vector<BoundingBox> &boundingBoxes, std::vector<LidarPoint> &lidarPoints, float shrinkFactor, cv::Mat &P_rect_xx, cv::Mat &R_rect_xx, cv::Mat &RT);
+// associates the Lidar points projected into exactly one (shrunk) bounding box with that box; the points are looked
+// up by scanning the regions of the depth image (see projectLidarPoints) covered by the boxes
+void clusterLidarWithROI(std::vector<BoundingBox> &boundingBoxes, const std::vector<LidarPoint> &lidarPoints,
+                         const DepthImage &depthImage, float shrinkFactor);
+// keeps only the largest Euclidean cluster (with the given tolerance) of the Lidar points of every bounding box;
+// the index must be built over the point cloud the boxes' lidarPointIndices refer to
+void removeLidarOutliers(std::vector<BoundingBox> &boundingBoxes, const LidarIndex &index, float clusterTolerance);
+// computes the range statistics of every bounding box from at most maxPoints evenly spaced Lidar points of the box,
+// zero means all of them; the statistics serve the Lidar TTC of the box as both the current and the previous box
+void computeLidarRangeStats(std::vector<BoundingBox> &boundingBoxes, const std::vector<LidarPoint> &lidarPoints,
+                            size_t maxPoints);
+// associates the keypoint matches enclosed by the box, except for the 20% of them which moved the most, with the box
 void clusterKptMatchesWithROI(BoundingBox &boundingBox, std::vector<cv::KeyPoint> &kptsPrev, std::vector<cv::KeyPoint> &kptsCurr, std::vector<cv::DMatch> &kptMatches);
-void matchBoundingBoxes(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches, DataFrame &prevFrame, DataFrame &currFrame);
+// one-to-one association of the bounding boxes of the previous and the current frames by the number of keypoint
+// matches they share; pairs sharing fewer than minSupport matches are never associated
+void matchBoundingBoxes(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches, DataFrame &prevFrame, DataFrame &currFrame,
+                        size_t minSupport=1);
 
-void show3DObjects(const std::vector<BoundingBox>& boundingBoxes, const cv::Size& worldSize, const cv::Size& imageSize, int img_id, bool bWait=true);
+// carries the bounding boxes of the previous frame over into the current frame by shifting and scaling each box
+// with the median motion of the keypoint matches it encloses; returns false if there are no boxes to carry over
+// or some box is supported by fewer than minSupport matches, in which case the object detector should be run instead
+bool propagateBoundingBoxes(const std::vector<BoundingBox> &prevBoxes, const std::vector<cv::KeyPoint> &kptsPrev,
+                            const std::vector<cv::KeyPoint> &kptsCurr, const std::vector<cv::DMatch> &kptMatches,
+                            std::vector<BoundingBox> &currBoxes, size_t minSupport);
+
+// predicts where every keypoint of the current frame will be in the next frame, assuming that each tracked box keeps
+// moving by the median motion of the matches it shares with its predecessor and that everything outside of the boxes
+// moves by the median motion of the remaining matches (the ego motion); keypoints in untracked boxes, in several boxes
+// or in boxes supported by fewer than minSupport matches are predicted at NaN
+void predictKeypointPositions(const DataFrame &prevFrame, const DataFrame &currFrame, size_t minSupport,
+                              std::vector<cv::Point2f> &predictions);
+
+void show3DObjects(const std::vector<BoundingBox>& boundingBoxes, const std::vector<LidarPoint>& lidarPoints,
+                   const cv::Size& worldSize, const cv::Size& imageSize, int img_id, bool bWait=true);
 
 void computeTTCCamera(std::vector<cv::KeyPoint> &kptsPrev, std::vector<cv::KeyPoint> &kptsCurr,
                       std::vector<cv::DMatch> kptMatches, double frameRate, double &TTC);
 void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev,
                      std::vector<LidarPoint> &lidarPointsCurr, double frameRate, double &TTC);                  
+
+// variants reporting the uncertainty of the estimates for the TTC fusion; the Camera variant evaluates at most
+// maxPairs randomly chosen keypoint match pairs, and the Lidar variant considers at most maxPoints evenly spaced
+// points of each box and also reports the current distance to the object; zero disables the subsampling;
+// the matches and the points are views over the arrays of the frames (e.g., selected by the indices of a box)
+void computeTTCCamera(const std::vector<cv::KeyPoint> &kptsPrev, const std::vector<cv::KeyPoint> &kptsCurr,
+                      IndexedView<cv::DMatch> kptMatches, double frameRate, double &TTC, double &ttcVariance,
+                      size_t maxPairs);
+void computeTTCLidar(IndexedView<LidarPoint> lidarPointsPrev, IndexedView<LidarPoint> lidarPointsCurr,
+                     double frameRate, double &TTC, double &rangeCurr, double &rangeVariance, size_t maxPoints);
+// the same from the range statistics of the boxes (see computeLidarRangeStats); the TTC is NaN if either box has
+// fewer Lidar points than the statistics need
+void computeTTCLidar(const LidarRangeStats &statsPrev, const LidarRangeStats &statsCurr, double frameRate,
+                     double &TTC, double &rangeCurr, double &rangeVariance);
 #endif /* camFusion_hpp */
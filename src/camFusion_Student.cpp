@@ -3,8 +3,11 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <cstdint>
 #include <set>
 #include <iterator>
+#include <limits>
+#include <unordered_map>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -13,64 +16,113 @@
 
 using namespace std;
 
+// the distance to the preceding vehicle is the average X-coordinate of the (P+1)th to Kth closest Lidar points
+constexpr size_t kLidarRangeK = 10;
+constexpr size_t kLidarRangeP = 5;
+
+// lower bound of the variance of a Lidar-derived distance [m^2], i.e., the sensor's range precision squared
+constexpr double kLidarRangeVarianceFloor = 0.02 * 0.02;
+
 
 // Create groups of Lidar points whose projection into the camera falls into the same bounding box
-void clusterLidarWithROI(std::vector<BoundingBox> &boundingBoxes, std::vector<LidarPoint> &lidarPoints, float shrinkFactor, cv::Mat &P_rect_xx, cv::Mat &R_rect_xx, cv::Mat &RT)
+// calls visit(i) for every point i of the depth image projected into the given box; only the cells overlapped by
+// the box are scanned
+template <typename Visitor>
+static void scanDepthImage(const DepthImage &depthImage, const cv::Rect &box, Visitor visit)
 {
-    // loop over all Lidar points and associate them to a 2D bounding box
-    cv::Mat X(4, 1, cv::DataType<double>::type);
-    cv::Mat Y(3, 1, cv::DataType<double>::type);
-
-    for (auto it1 = lidarPoints.begin(); it1 != lidarPoints.end(); ++it1)
-    {
-        // assemble vector for matrix-vector-multiplication
-        X.at<double>(0, 0) = it1->x;
-        X.at<double>(1, 0) = it1->y;
-        X.at<double>(2, 0) = it1->z;
-        X.at<double>(3, 0) = 1;
-
-        // project Lidar point into camera
-        Y = P_rect_xx * R_rect_xx * RT * X;
-        cv::Point pt;
-        pt.x = Y.at<double>(0, 0) / Y.at<double>(2, 0); // pixel coordinates
-        pt.y = Y.at<double>(1, 0) / Y.at<double>(2, 0);
-
-        vector<vector<BoundingBox>::iterator> enclosingBoxes; // pointers to all bounding boxes which enclose the current Lidar point
-        for (auto it2 = boundingBoxes.begin(); it2 != boundingBoxes.end(); ++it2)
+    const cv::Rect cells = cv::Rect(0, 0, depthImage.gridSize.width, depthImage.gridSize.height) &
+                           cv::Rect(cv::Point(std::max(box.x, 0) / depthImage.cellSize,
+                                              std::max(box.y, 0) / depthImage.cellSize),
+                                    cv::Point(std::max(box.x + box.width, 0) / depthImage.cellSize + 1,
+                                              std::max(box.y + box.height, 0) / depthImage.cellSize + 1));
+    for (int cy = cells.y; cy < cells.y + cells.height; ++cy)
+    {
+        for (int cx = cells.x; cx < cells.x + cells.width; ++cx)
         {
-            // shrink current bounding box slightly to avoid having too many outlier points around the edges
-            cv::Rect smallerBox;
-            smallerBox.x = (*it2).roi.x + shrinkFactor * (*it2).roi.width / 2.0;
-            smallerBox.y = (*it2).roi.y + shrinkFactor * (*it2).roi.height / 2.0;
-            smallerBox.width = (*it2).roi.width * (1 - shrinkFactor);
-            smallerBox.height = (*it2).roi.height * (1 - shrinkFactor);
-
-            // check wether point is within current bounding box
-            if (smallerBox.contains(pt))
+            for (int i = depthImage.cellHead[cy * depthImage.gridSize.width + cx]; i >= 0; i = depthImage.nextPoint[i])
             {
-                enclosingBoxes.push_back(it2);
+                if (box.contains(depthImage.imagePoints[i]))
+                {
+                    visit(static_cast<size_t>(i));
+                }
             }
+        }
+    }
+}
 
-        } // eof loop over all bounding boxes
+void clusterLidarWithROI(std::vector<BoundingBox> &boundingBoxes, const std::vector<LidarPoint> &lidarPoints,
+                         const DepthImage &depthImage, float shrinkFactor)
+{
+    // shrink each bounding box slightly to avoid having too many outlier points around the edges
+    std::vector<cv::Rect> smallerBoxes;
+    for (const auto &box : boundingBoxes)
+    {
+        cv::Rect smallerBox;
+        smallerBox.x = box.roi.x + shrinkFactor * box.roi.width / 2.0;
+        smallerBox.y = box.roi.y + shrinkFactor * box.roi.height / 2.0;
+        smallerBox.width = box.roi.width * (1 - shrinkFactor);
+        smallerBox.height = box.roi.height * (1 - shrinkFactor);
+        smallerBoxes.push_back(smallerBox);
+    }
 
-        // check wether point has been enclosed by one or by multiple boxes
-        if (enclosingBoxes.size() == 1)
-        { 
-            // add Lidar point to bounding box
-            enclosingBoxes[0]->lidarPoints.push_back(*it1);
-        }
+    // count the bounding boxes enclosing each Lidar point (saturating at two)
+    std::vector<uint8_t> enclosures(lidarPoints.size(), 0);
+    for (const auto &smallerBox : smallerBoxes)
+    {
+        scanDepthImage(depthImage, smallerBox, [&enclosures](size_t i)
+        {
+            enclosures[i] = std::min(enclosures[i] + 1, 2);
+        });
+    }
+
+    // associate the points enclosed by a single box with it; the points are kept in the order of the cloud
+    std::vector<size_t> indices;
+    for (size_t b = 0; b < boundingBoxes.size(); ++b)
+    {
+        indices.clear();
+        scanDepthImage(depthImage, smallerBoxes[b], [&enclosures, &indices](size_t i)
+        {
+            if (enclosures[i] == 1)
+            {
+                indices.push_back(i);
+            }
+        });
+        std::sort(indices.begin(), indices.end());
 
-    } // eof loop over all Lidar points
+        for (auto i : indices)
+        {
+            boundingBoxes[b].lidarPointIndices.push_back(i);
+        }
+    }
 }
 
 
+void removeLidarOutliers(std::vector<BoundingBox> &boundingBoxes, const LidarIndex &index, float clusterTolerance)
+{
+    std::vector<std::vector<size_t>> clusters;
+    for (auto &box : boundingBoxes)
+    {
+        // the object itself is assumed to be the largest cluster of the box; the isolated returns
+        // (e.g., dust, reflections, points of the objects behind) form the other clusters
+        index.euclideanClusters(box.lidarPointIndices, clusterTolerance, 1, clusters);
+        if (clusters.size() <= 1)
+        {
+            continue;
+        }
+
+        std::vector<size_t> &objectCluster = clusters.front();
+        std::sort(objectCluster.begin(), objectCluster.end());
+        box.lidarPointIndices.swap(objectCluster);
+    }
+}
+
 /*
  * The show3DObjects() function below can handle different output image sizes, but the text output has been manually
  * tuned to fit the 2000x2000 size. However, you can make this function work for other sizes too.
  * For instance, to use a 1000x1000 size, adjusting the text positions by dividing them by 2.
  */
 void show3DObjects(
-const std::vector<BoundingBox>& boundingBoxes,
+const std::vector<BoundingBox>& boundingBoxes, const std::vector<LidarPoint>& lidarPoints,
 const cv::Size& worldSize, const cv::Size& imageSize, const int img_id, const bool bWait)
 {
     // create topview image
@@ -85,7 +137,7 @@ const cv::Size& worldSize, const cv::Size& imageSize, const int img_id, const bo
         // plot Lidar points into top view image
         int top=1e8, left=1e8, bottom=0.0, right=0.0; 
         float xwmin=1e8, ywmin=1e8, ywmax=-1e8;
-        for (const auto& lidarPoint : boundingBox.lidarPoints)
+        for (const auto& lidarPoint : IndexedView<LidarPoint>(lidarPoints, boundingBox.lidarPointIndices))
         {
             // world coordinates
             auto xw = static_cast<float>(lidarPoint.x); // world position in m with x facing forward from sensor
@@ -113,7 +165,7 @@ const cv::Size& worldSize, const cv::Size& imageSize, const int img_id, const bo
 
         // augment object with some key data
         char str1[200], str2[200];
-        sprintf(str1, "img_id=%d, id=%d, #pts=%d", img_id, boundingBox.boxID, (int)boundingBox.lidarPoints.size());
+        sprintf(str1, "img_id=%d, id=%d, #pts=%d", img_id, boundingBox.boxID, (int)boundingBox.lidarPointIndices.size());
         putText(topviewImg, str1, cv::Point2f(left-250, bottom+50), cv::FONT_ITALIC, 2, currColor);
         sprintf(str2, "xmin=%2.2f m, yw=%2.2f m", xwmin, ywmax-ywmin);
         putText(topviewImg, str2, cv::Point2f(left-250, bottom+125), cv::FONT_ITALIC, 2, currColor);  
@@ -160,23 +212,14 @@ void clusterKptMatchesWithROI(BoundingBox &boundingBox, std::vector<cv::KeyPoint
         }
     }
 
-    const double euclideanDistanceMean =
-            std::accumulate(euclideanDistances.begin(), euclideanDistances.end(), 0.0) / euclideanDistances.size();
-    const double euclideanDistanceStandardDeviation = std::sqrt(
-            std::accumulate(euclideanDistances.begin(), euclideanDistances.end(), 0.0,
-                            [&euclideanDistanceMean](const double sum, const double dist)
-                            {
-                                double deviation = dist - euclideanDistanceMean;
-                                return sum + deviation * deviation;
-                            }) / euclideanDistances.size());
-
     auto r_offset = static_cast<size_t>(round(filterOutliersRatio * euclideanDistances.size()));
     auto it = euclideanDistances.crbegin();
     std::advance(it, r_offset);
     const double filterKptsWithDistHigherThan = *it;
 
-    for (const auto& match : kptMatches)
+    for (size_t i = 0; i < kptMatches.size(); ++i)
     {
+        const auto& match = kptMatches[i];
         const auto& currKpt = kptsCurr[match.trainIdx];
 
         if (boundingBox.roi.contains(currKpt.pt))
@@ -185,18 +228,10 @@ void clusterKptMatchesWithROI(BoundingBox &boundingBox, std::vector<cv::KeyPoint
             const double euclideanDistance = cv::norm(currKpt.pt - prevKpt.pt);
             if (euclideanDistance <= filterKptsWithDistHigherThan)
             {
-                boundingBox.keypoints.push_back(currKpt);
-                boundingBox.kptMatches.push_back(match);
+                boundingBox.kptMatchIndices.push_back(i);
             }
         }
     }
-
-    std::cout << "[clusterKptMatchesWithROI]: points in ROI for BB "
-              << boundingBox.boxID << " before filtering: " << euclideanDistances.size()
-              << "; after filtering: " << boundingBox.keypoints.size()
-              << "; Euclidean Distance Mean: " << euclideanDistanceMean
-              << "; Euclidean distance standard deviation: " << euclideanDistanceStandardDeviation
-              << std::endl;
 }
 
 
@@ -204,40 +239,78 @@ void clusterKptMatchesWithROI(BoundingBox &boundingBox, std::vector<cv::KeyPoint
 void computeTTCCamera(std::vector<cv::KeyPoint> &kptsPrev, std::vector<cv::KeyPoint> &kptsCurr, 
                       std::vector<cv::DMatch> kptMatches, double frameRate, double &TTC)
 {
+    double ttcVariance;
+    computeTTCCamera(kptsPrev, kptsCurr, kptMatches, frameRate, TTC, ttcVariance, 0);
+}
+
+
+void computeTTCCamera(const std::vector<cv::KeyPoint> &kptsPrev, const std::vector<cv::KeyPoint> &kptsCurr,
+                      IndexedView<cv::DMatch> kptMatches, double frameRate, double &TTC, double &ttcVariance,
+                      size_t maxPairs)
+{
+    TTC = NAN;
+    ttcVariance = NAN;
+    if (kptMatches.size() < 2)
+    {
+        return;
+    }
+
+    const double minDist = 100.0; // min. required distance
+
     // compute distance ratios between all matched keypoints
     vector<double> distRatios; // stores the distance ratios for all keypoints between curr. and prev. frame
-    for (auto it1 = kptMatches.begin(); it1 != kptMatches.end() - 1; ++it1)
-    { // outer kpt. loop
-
+    auto addDistRatio = [&](const cv::DMatch &outer, const cv::DMatch &inner)
+    {
         // get current keypoint and its matched partner in the prev. frame
-        cv::KeyPoint kpOuterCurr = kptsCurr.at(it1->trainIdx);
-        cv::KeyPoint kpOuterPrev = kptsPrev.at(it1->queryIdx);
-
-        for (auto it2 = kptMatches.begin() + 1; it2 != kptMatches.end(); ++it2)
-        { // inner kpt.-loop
+        const cv::KeyPoint &kpOuterCurr = kptsCurr.at(outer.trainIdx);
+        const cv::KeyPoint &kpOuterPrev = kptsPrev.at(outer.queryIdx);
 
-            double minDist = 100.0; // min. required distance
+        // get next keypoint and its matched partner in the prev. frame
+        const cv::KeyPoint &kpInnerCurr = kptsCurr.at(inner.trainIdx);
+        const cv::KeyPoint &kpInnerPrev = kptsPrev.at(inner.queryIdx);
 
-            // get next keypoint and its matched partner in the prev. frame
-            cv::KeyPoint kpInnerCurr = kptsCurr.at(it2->trainIdx);
-            cv::KeyPoint kpInnerPrev = kptsPrev.at(it2->queryIdx);
+        // compute distances and distance ratios
+        double distCurr = cv::norm(kpOuterCurr.pt - kpInnerCurr.pt);
+        double distPrev = cv::norm(kpOuterPrev.pt - kpInnerPrev.pt);
 
-            // compute distances and distance ratios
-            double distCurr = cv::norm(kpOuterCurr.pt - kpInnerCurr.pt);
-            double distPrev = cv::norm(kpOuterPrev.pt - kpInnerPrev.pt);
+        if (distPrev > std::numeric_limits<double>::epsilon() && distCurr >= minDist)
+        { // avoid division by zero
+            double distRatio = distCurr / distPrev;
+            distRatios.push_back(distRatio);
+        }
+    };
 
-            if (distPrev > std::numeric_limits<double>::epsilon() && distCurr >= minDist)
-            { // avoid division by zero
-                double distRatio = distCurr / distPrev;
-                distRatios.push_back(distRatio);
+    const size_t numPairs = (kptMatches.size() - 1) * (kptMatches.size() - 1);
+    if (maxPairs == 0 or numPairs <= maxPairs)
+    {
+        for (auto it1 = kptMatches.begin(); it1 != kptMatches.end() - 1; ++it1)
+        { // outer kpt. loop
+            for (auto it2 = kptMatches.begin() + 1; it2 != kptMatches.end(); ++it2)
+            { // inner kpt.-loop
+                addDistRatio(*it1, *it2);
+            } // eof inner loop over all matched kpts
+        }     // eof outer loop over all matched kpts
+    }
+    else
+    {
+        // subsampled mode: a random subset of the pairs; the generator is seeded deterministically,
+        // so that the estimates are reproducible
+        cv::RNG rng(kptMatches.size());
+        const auto numMatches = static_cast<int>(kptMatches.size());
+        for (size_t pair = 0; pair < maxPairs; ++pair)
+        {
+            const int outer = rng.uniform(0, numMatches);
+            const int inner = rng.uniform(0, numMatches);
+            if (outer != inner)
+            {
+                addDistRatio(kptMatches[outer], kptMatches[inner]);
             }
-        } // eof inner loop over all matched kpts
-    }     // eof outer loop over all matched kpts
+        }
+    }
 
     // only continue if list of distance ratios is not empty
     if (distRatios.empty())
     {
-        TTC = NAN;
         return;
     }
 
@@ -249,48 +322,215 @@ void computeTTCCamera(std::vector<cv::KeyPoint> &kptsPrev, std::vector<cv::KeyPo
 
     double dT = 1 / frameRate;
     TTC = -dT / (1 - medDistRatio);
+
+    // the uncertainty of the median ratio is estimated with the median absolute deviation (MAD) scaled to
+    // the standard deviation of the normal distribution, and is propagated to the TTC through dTTC/dRatio;
+    // the pairwise ratios are built from only as many independent measurements as there are matches
+    for (auto &distRatio : distRatios)
+    {
+        distRatio = std::abs(distRatio - medDistRatio);
+    }
+    std::nth_element(distRatios.begin(), distRatios.begin() + medIndex, distRatios.end());
+    const size_t numSamples = std::min(distRatios.size(), kptMatches.size());
+    const double ratioStd = 1.4826 * distRatios[medIndex] / std::sqrt(static_cast<double>(numSamples));
+    const double dTTCdRatio = dT / ((1 - medDistRatio) * (1 - medDistRatio));
+    ttcVariance = dTTCdRatio * dTTCdRatio * ratioStd * ratioStd;
+}
+
+
+
+// returns the X-coordinates of up to maxPoints evenly spaced points, but never fewer than needed to estimate
+// the distance; zero means all the points
+static std::vector<double> gatherLidarRanges(IndexedView<LidarPoint> lidarPoints, size_t maxPoints)
+{
+    size_t stride = 1;
+    if (maxPoints > 0)
+    {
+        maxPoints = std::max(maxPoints, kLidarRangeK);
+        stride = (lidarPoints.size() + maxPoints - 1) / maxPoints;
+    }
+
+    std::vector<double> ranges;
+    ranges.reserve((lidarPoints.size() + stride - 1) / stride);
+    for (size_t i = 0; i < lidarPoints.size(); i += stride)
+    {
+        ranges.push_back(lidarPoints[i].x);
+    }
+
+    return ranges;
 }
 
+// estimates the distance to the preceding vehicle from the X-coordinates of the closest points and the variance
+// of this estimate; the range is undefined if there are fewer than K points
+static LidarRangeStats estimateLidarRange(IndexedView<LidarPoint> lidarPoints, size_t maxPoints)
+{
+    const size_t K = kLidarRangeK;
+    const size_t P = kLidarRangeP;
+
+    LidarRangeStats stats;
+    std::vector<double> ranges = gatherLidarRanges(lidarPoints, maxPoints);
+    stats.pointCount = ranges.size();
+    if (ranges.size() < K)
+    {
+        return stats;
+    }
+
+    // only the K closest points are sorted, in O(N*log(K)) time, where N is the number of lidar points and K << N
+    std::partial_sort(ranges.begin(), ranges.begin() + K, ranges.end());
+    stats.nearestX.assign(ranges.begin(), ranges.begin() + K);
+
+    // take average of (P+1)th to Kth closest point to compute the distance to the preceding vehicle
+    stats.range = std::accumulate(stats.nearestX.begin() + P, stats.nearestX.end(), 0.0) / (K - P);
+
+    // variance of the mean of the averaged points, bounded from below by the sensor's range precision
+    const double range = stats.range;
+    auto sqDevOp = [range](const double sum, const double x) { return sum + (x - range) * (x - range); };
+    const double pointVariance =
+            std::accumulate(stats.nearestX.begin() + P, stats.nearestX.end(), 0.0, sqDevOp) / (K - P - 1);
+    stats.spread = std::sqrt(pointVariance);
+    stats.rangeVariance = std::max(pointVariance / (K - P), kLidarRangeVarianceFloor);
+    return stats;
+}
+
+void computeLidarRangeStats(std::vector<BoundingBox> &boundingBoxes, const std::vector<LidarPoint> &lidarPoints,
+                            size_t maxPoints)
+{
+    for (auto &box : boundingBoxes)
+    {
+        box.lidarRange = estimateLidarRange(IndexedView<LidarPoint>(lidarPoints, box.lidarPointIndices), maxPoints);
+    }
+}
 
 void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev,
                      std::vector<LidarPoint> &lidarPointsCurr, double frameRate, double &TTC)
 {
-    // make a min-heap out of lidar points in-place with respect to the X coordinate;
-    // we want to extract K minimum elements from arrays of lidar points to compute statistically
-    // reliable distance to the preceding vehicle;
-    // we can achieve O(N + K*log(N)) time complexity with the heap in comparison to sorting (O(N*log(N))),
-    // where N is the number of lidar points and K << N (significantly less than)
-
-    const size_t K = 10;
-    const size_t P = 5;
-    assert (K <= lidarPointsPrev.size() and K <= lidarPointsCurr.size());
+    double rangeCurr, rangeVariance;
+    computeTTCLidar(lidarPointsPrev, lidarPointsCurr, frameRate, TTC, rangeCurr, rangeVariance, 0);
+}
 
-    // we use > with respect to x coordinate because std::make_heap makes a max heap w.r.t. less operator
-    auto cmpFunc = [](const LidarPoint& lp1, const LidarPoint& lp2) { return lp1.x > lp2.x; };
 
-    std::make_heap(lidarPointsPrev.begin(), lidarPointsPrev.end(), cmpFunc);
-    // the first K elements in the array will be the K minimum distance elements w.r.t. X coordinates
-    // sorted in the descending order, that is, the Kth closes element will be the first one and the closest one
-    // will be on the Kth position (index K-1)
-    std::sort_heap(lidarPointsPrev.begin(), lidarPointsPrev.begin(), cmpFunc);
+void computeTTCLidar(IndexedView<LidarPoint> lidarPointsPrev, IndexedView<LidarPoint> lidarPointsCurr,
+                     double frameRate, double &TTC, double &rangeCurr, double &rangeVariance, size_t maxPoints)
+{
+    computeTTCLidar(estimateLidarRange(lidarPointsPrev, maxPoints), estimateLidarRange(lidarPointsCurr, maxPoints),
+                    frameRate, TTC, rangeCurr, rangeVariance);
+}
 
-    std::make_heap(lidarPointsCurr.begin(), lidarPointsCurr.end(), cmpFunc);
-    std::sort_heap(lidarPointsCurr.begin(), lidarPointsCurr.begin(), cmpFunc);
 
-    // take average of (K-P)th to Kth point to compute the distance to the preceding vehicle
-    auto sumOp = [](const double sum, const LidarPoint& lp) { return sum + lp.x; };
-    double prevMeanX = std::accumulate(lidarPointsPrev.begin()+P, lidarPointsPrev.begin()+K, 0.0, sumOp) / (K - P);
-    double currMeanX = std::accumulate(lidarPointsCurr.begin()+P, lidarPointsCurr.begin()+K, 0.0, sumOp) / (K - P);
+void computeTTCLidar(const LidarRangeStats &statsPrev, const LidarRangeStats &statsCurr, double frameRate,
+                     double &TTC, double &rangeCurr, double &rangeVariance)
+{
+    rangeCurr = statsCurr.range;
+    rangeVariance = statsCurr.rangeVariance;
 
     // compute TTC in accordance with the constant velocity motion model
     double T = 1.0 / frameRate;
-    TTC = currMeanX * T / (prevMeanX - currMeanX);
+    TTC = rangeCurr * T / (statsPrev.range - rangeCurr);
+}
+
+// returns the median of the given values; the order of the values is changed
+static double median(std::vector<double>& values)
+{
+    const size_t medIndex = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + medIndex, values.end());
+    const double upperMedian = values[medIndex];
+    if (values.size() % 2 != 0)
+    {
+        return upperMedian;
+    }
+
+    // for an even number of values, the lower median is the maximum of the lower half
+    const double lowerMedian = *std::max_element(values.begin(), values.begin() + medIndex);
+    return (lowerMedian + upperMedian) / 2.0;
 }
 
-static std::vector<size_t>
-findBoundingBoxesContainingKeypoint(const cv::KeyPoint &kpt, const std::vector<BoundingBox> &bounding_boxes)
+
+bool propagateBoundingBoxes(const std::vector<BoundingBox> &prevBoxes, const std::vector<cv::KeyPoint> &kptsPrev,
+                            const std::vector<cv::KeyPoint> &kptsCurr, const std::vector<cv::DMatch> &kptMatches,
+                            std::vector<BoundingBox> &currBoxes, size_t minSupport)
 {
-    std::vector<size_t> filtered_bounding_boxes;
+    const double minDist = 10.0; // min. distance from the median keypoint for a keypoint to take part in scaling
+
+    currBoxes.clear();
+    if (prevBoxes.empty())
+    {
+        return false; // objects entering an empty scene can only be found by the detector
+    }
+    vector<cv::Point2f> prevPts, currPts;
+    vector<double> values;
+    for (const auto &prevBox : prevBoxes)
+    {
+        // keypoint correspondences whose previous keypoint is enclosed by the previous box
+        prevPts.clear();
+        currPts.clear();
+        for (const auto &match : kptMatches)
+        {
+            const auto &prevKpt = kptsPrev[match.queryIdx];
+            if (prevBox.roi.contains(prevKpt.pt))
+            {
+                prevPts.push_back(prevKpt.pt);
+                currPts.push_back(kptsCurr[match.trainIdx].pt);
+            }
+        }
+
+        if (prevPts.size() < minSupport or prevPts.empty())
+        {
+            // the box cannot be propagated reliably; the caller has to run the object detector
+            return false;
+        }
+
+        // median keypoint positions in the previous and the current frames; the difference between them
+        // is robust to outlier matches and describes the shift of the box
+        cv::Point2f prevMedian, currMedian;
+        values.clear();
+        for (const auto &pt : prevPts) values.push_back(pt.x);
+        prevMedian.x = median(values);
+        values.clear();
+        for (const auto &pt : prevPts) values.push_back(pt.y);
+        prevMedian.y = median(values);
+        values.clear();
+        for (const auto &pt : currPts) values.push_back(pt.x);
+        currMedian.x = median(values);
+        values.clear();
+        for (const auto &pt : currPts) values.push_back(pt.y);
+        currMedian.y = median(values);
+
+        // the median ratio of distances to the median keypoint in the current and previous frames
+        // describes the change in the box scale, like in the camera-based TTC computation
+        values.clear();
+        for (size_t i = 0; i < prevPts.size(); ++i)
+        {
+            const double distPrev = cv::norm(prevPts[i] - prevMedian);
+            if (distPrev >= minDist)
+            {
+                values.push_back(cv::norm(currPts[i] - currMedian) / distPrev);
+            }
+        }
+        const double scale = values.empty() ? 1.0 : median(values);
+
+        // move the box corners along with the keypoints, scaling them around the median keypoint
+        BoundingBox currBox = prevBox;
+        currBox.boxID = static_cast<int>(currBoxes.size());
+        currBox.lidarPointIndices.clear();
+        currBox.kptMatchIndices.clear();
+        currBox.lidarRange = LidarRangeStats();
+        currBox.roi.x = static_cast<int>(std::round(currMedian.x + scale * (prevBox.roi.x - prevMedian.x)));
+        currBox.roi.y = static_cast<int>(std::round(currMedian.y + scale * (prevBox.roi.y - prevMedian.y)));
+        currBox.roi.width = std::max(1, static_cast<int>(std::round(scale * prevBox.roi.width)));
+        currBox.roi.height = std::max(1, static_cast<int>(std::round(scale * prevBox.roi.height)));
+
+        currBoxes.push_back(currBox);
+    }
+
+    return true;
+}
+
+// finds the indices of the bounding boxes containing the given keypoint; the result is written into an output
+// parameter, so that the caller can reuse its storage across keypoints
+static void findBoundingBoxesContainingKeypoint(const cv::KeyPoint &kpt, const std::vector<BoundingBox> &bounding_boxes,
+                                                std::vector<size_t> &filtered_bounding_boxes)
+{
+    filtered_bounding_boxes.clear();
     for (size_t i = 0; i < bounding_boxes.size(); ++i)
     {
         if (bounding_boxes[i].roi.contains(kpt.pt))
@@ -298,96 +538,184 @@ findBoundingBoxesContainingKeypoint(const cv::KeyPoint &kpt, const std::vector<B
             filtered_bounding_boxes.push_back(i);
         }
     }
-
-    return filtered_bounding_boxes;
 }
 
 
 void matchBoundingBoxes(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches,
-                        DataFrame &prevFrame, DataFrame &currFrame)
+                        DataFrame &prevFrame, DataFrame &currFrame, size_t minSupport)
 {
     const size_t prevBBSize = prevFrame.boundingBoxes.size();
     const size_t currBBSize = currFrame.boundingBoxes.size();
 
-    // 2D array storing the number of matched keypoints belonging
-    // to the given bounding boxes from the previous frame and the current frame;
-    // all elements are initialized to zero here
-    std::vector<std::vector<size_t>> cntKptsInMatchedBB(prevBBSize, std::vector<size_t>(currBBSize, 0ull));
+    // the number of matched keypoints belonging to the given bounding boxes from the previous frame and
+    // the current frame is accumulated in a single contiguous row-major matrix (prev. index, curr. index);
+    // if there are so many boxes that the matrix would be large and mostly empty, a sparse accumulator is used
+    const size_t maxDenseCells = 1u << 16u;
+    const bool bDense = prevBBSize * currBBSize <= maxDenseCells;
+    std::vector<size_t> cntDense(bDense ? prevBBSize * currBBSize : 0, 0);
+    std::unordered_map<size_t, size_t> cntSparse;
 
     // matches array contains all the matched keypoints between the previous and current frames
+    std::vector<size_t> prevBoxIndices, currBoxIndices;
     for (const auto& match : matches)
     {
-        // extract the keypoints for the corresponding match
-        const auto& prevKpt = prevFrame.keypoints[match.queryIdx];
-        const auto& currKpt = currFrame.keypoints[match.trainIdx];
+        // find bounding boxes in the previous and the current frames to which the matched keypoints belong to
+        findBoundingBoxesContainingKeypoint(prevFrame.keypoints[match.queryIdx], prevFrame.boundingBoxes,
+                                            prevBoxIndices);
+        if (prevBoxIndices.empty())
+        {
+            continue;
+        }
+        findBoundingBoxesContainingKeypoint(currFrame.keypoints[match.trainIdx], currFrame.boundingBoxes,
+                                            currBoxIndices);
 
-        // find bounding boxes in the previous frame to which the given prevKpt belongs to
-        const auto prevBoxIDs = findBoundingBoxesContainingKeypoint(prevKpt, prevFrame.boundingBoxes);
-        const auto currBoxIDs = findBoundingBoxesContainingKeypoint(currKpt, currFrame.boundingBoxes);
+        // update the number of matched keypoints from previous and current frames
+        for (auto prevInd : prevBoxIndices)
+        {
+            for (auto currInd : currBoxIndices)
+            {
+                const size_t cell = prevInd * currBBSize + currInd;
+                if (bDense)
+                {
+                    ++cntDense[cell];
+                }
+                else
+                {
+                    ++cntSparse[cell];
+                }
+            }
+        }
+    }
 
-        // update the number of matched keypoints from previous and current frames in the cntKptsInMatchedBB
-        for (auto prevBBID : prevBoxIDs)
+    // candidate pairs of bounding boxes having enough matched keypoints in common
+    struct Candidate
+    {
+        size_t count;
+        size_t cell;
+    };
+    std::vector<Candidate> candidates;
+    if (bDense)
+    {
+        for (size_t cell = 0; cell < cntDense.size(); ++cell)
         {
-            for (auto currBBID : currBoxIDs)
+            if (cntDense[cell] >= minSupport and cntDense[cell] > 0)
             {
-                ++cntKptsInMatchedBB[prevBBID][currBBID];
+                candidates.push_back({cntDense[cell], cell});
+            }
+        }
+    }
+    else
+    {
+        for (const auto& cnt : cntSparse)
+        {
+            if (cnt.second >= minSupport)
+            {
+                candidates.push_back({cnt.second, cnt.first});
             }
         }
     }
 
-    // search for the maximum number of matches within bounding boxes;
-    // there are no more correspondences between bounding boxes of previous and current frames than the minimum
-    // number of bounding boxes among those frames;
-    // since there should be no big difference in the number of identified bounding boxes in the previous
-    // and current frames, we extract indices of maximum elements for both cases
-    std::vector<size_t> max_prev_indices(currBBSize, 0ull);   // all elements are initialized to zero here
-    std::vector<size_t> max_curr_indices(prevBBSize, 0ull);   //
+    // one-to-one assignment greedy by the number of matched keypoints: the pair with the most matches is
+    // assigned first, and the boxes assigned once are not considered again;
+    // ties are broken by the indices, so that the result does not depend on the accumulator used
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs)
+    {
+        return lhs.count != rhs.count ? lhs.count > rhs.count : lhs.cell < rhs.cell;
+    });
 
-    for (size_t prev_ind = 0; prev_ind < prevBBSize; ++prev_ind)
+    std::vector<bool> prevAssigned(prevBBSize, false);
+    std::vector<bool> currAssigned(currBBSize, false);
+    for (const auto& candidate : candidates)
     {
-        for (size_t curr_ind = 0; curr_ind < currBBSize; ++curr_ind)
+        const size_t prevInd = candidate.cell / currBBSize;
+        const size_t currInd = candidate.cell % currBBSize;
+        if (prevAssigned[prevInd] or currAssigned[currInd])
         {
-            max_prev_indices[curr_ind] =
-                    cntKptsInMatchedBB[prev_ind][curr_ind] > cntKptsInMatchedBB[max_prev_indices[curr_ind]][curr_ind]
-                    ? prev_ind : max_prev_indices[curr_ind];
-
-            max_curr_indices[prev_ind] =
-                    cntKptsInMatchedBB[prev_ind][curr_ind] > cntKptsInMatchedBB[prev_ind][max_curr_indices[prev_ind]]
-                    ? curr_ind : max_curr_indices[prev_ind];
+            continue;
         }
+
+        prevAssigned[prevInd] = true;
+        currAssigned[currInd] = true;
+        bbBestMatches[prevFrame.boundingBoxes[prevInd].boxID] = currFrame.boundingBoxes[currInd].boxID;
     }
+}
+
+
+void predictKeypointPositions(const DataFrame &prevFrame, const DataFrame &currFrame, size_t minSupport,
+                              std::vector<cv::Point2f> &predictions)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const std::vector<BoundingBox> &prevBoxes = prevFrame.boundingBoxes;
+    const std::vector<BoundingBox> &currBoxes = currFrame.boundingBoxes;
 
-    // fill in the bbBestMatches based on the minimum number of bounding boxes because otherwise there might be
-    // that one BB corresponds to two or more other
-    if (prevBBSize <= currBBSize)
+    // the index of the previous box each current box is associated with, -1 for the untracked boxes
+    std::vector<int> prevBoxIndices(currBoxes.size(), -1);
+    for (const auto &bbMatch : currFrame.bbMatches)
     {
-        for (size_t curr_ind = 0; curr_ind < currBBSize; ++curr_ind)
+        for (size_t i = 0; i < prevBoxes.size(); ++i)
         {
-            auto prevBoxID = prevFrame.boundingBoxes[max_prev_indices[curr_ind]].boxID;
-            auto currBoxID = currFrame.boundingBoxes[curr_ind].boxID;
-
-            bbBestMatches[prevBoxID] = currBoxID;
+            for (size_t j = 0; j < currBoxes.size(); ++j)
+            {
+                if (prevBoxes[i].boxID == bbMatch.first and currBoxes[j].boxID == bbMatch.second)
+                {
+                    prevBoxIndices[j] = static_cast<int>(i);
+                }
+            }
+        }
+    }
 
-            // the logic of this project assumes that the following asserts are true;
-            // it may not be true if similar logic is applied in some other project
-            assert (static_cast<size_t>(prevBoxID) == max_prev_indices[curr_ind]);
-            assert (static_cast<size_t>(currBoxID) == curr_ind);
+    // motions of the matched keypoints grouped by the current box enclosing them; the last group holds the
+    // motions outside of all boxes, and the matches which moved between unassociated boxes are left out
+    std::vector<std::vector<cv::Point2f>> motions(currBoxes.size() + 1);
+    std::vector<size_t> boxIndices;
+    for (const auto &match : currFrame.kptMatches)
+    {
+        const auto &prevKpt = prevFrame.keypoints[match.queryIdx];
+        const auto &currKpt = currFrame.keypoints[match.trainIdx];
+        findBoundingBoxesContainingKeypoint(currKpt, currBoxes, boxIndices);
+        if (boxIndices.empty())
+        {
+            motions.back().push_back(currKpt.pt - prevKpt.pt);
+        }
+        else if (boxIndices.size() == 1 and prevBoxIndices[boxIndices[0]] >= 0 and
+                 prevBoxes[prevBoxIndices[boxIndices[0]]].roi.contains(prevKpt.pt))
+        {
+            motions[boxIndices[0]].push_back(currKpt.pt - prevKpt.pt);
         }
     }
-    else
+
+    // the median motion of each group is robust to outlier matches; the groups supported by too few matches
+    // (in particular the untracked boxes) have no motion
+    std::vector<cv::Point2f> medianMotions(motions.size(), cv::Point2f(nan, nan));
+    std::vector<double> values;
+    for (size_t i = 0; i < motions.size(); ++i)
     {
-        for (size_t prev_ind = 0; prev_ind < prevBBSize; ++prev_ind)
+        if (motions[i].size() < minSupport or motions[i].empty())
         {
-            auto prevBoxID = prevFrame.boundingBoxes[prev_ind].boxID;
-            auto currBoxID = currFrame.boundingBoxes[max_curr_indices[prev_ind]].boxID;
+            continue;
+        }
 
-            bbBestMatches[prevBoxID] = currBoxID;
+        values.clear();
+        for (const auto &motion : motions[i]) values.push_back(motion.x);
+        medianMotions[i].x = static_cast<float>(median(values));
+        values.clear();
+        for (const auto &motion : motions[i]) values.push_back(motion.y);
+        medianMotions[i].y = static_cast<float>(median(values));
+    }
 
-            // the logic of this project assumes that the following asserts are true;
-            // it may not be true if similar logic is applied in some other project
-            assert (static_cast<size_t>(prevBoxID) == prev_ind);
-            assert (static_cast<size_t>(currBoxID) == max_curr_indices[prev_ind]);
+    // constant motion from the current into the next frame; the keypoints in overlapping boxes are ambiguous
+    predictions.clear();
+    predictions.reserve(currFrame.keypoints.size());
+    for (const auto &kpt : currFrame.keypoints)
+    {
+        findBoundingBoxesContainingKeypoint(kpt, currBoxes, boxIndices);
+        if (boxIndices.size() > 1)
+        {
+            predictions.emplace_back(nan, nan);
+        }
+        else
+        {
+            predictions.push_back(kpt.pt + medianMotions[boxIndices.empty() ? currBoxes.size() : boxIndices[0]]);
         }
     }
-
 }
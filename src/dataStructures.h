@@ -4,12 +4,26 @@
 
 #include <vector>
 #include <map>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <opencv2/core.hpp>
 
+#include "FrameImages.hpp"
+#include "IndexedView.hpp"
+
 struct LidarPoint { // single lidar point in space
     double x,y,z,r; // x,y,z in [m], r is point reflectivity
 };
 
+struct LidarRangeStats { // robust distance to an object from the X-coordinates of its closest Lidar points
+    size_t pointCount = 0; // no. of points the statistics are computed from
+    std::vector<double> nearestX; // X-coordinates of the K closest points in ascending order
+    double range = std::numeric_limits<double>::quiet_NaN(); // mean of nearestX without the P closest ones [m]
+    double spread = std::numeric_limits<double>::quiet_NaN(); // standard deviation of the averaged values [m]
+    double rangeVariance = std::numeric_limits<double>::quiet_NaN(); // variance of range [m^2]
+};
+
 struct BoundingBox { // bounding box around a classified object (contains both 2D and 3D data)
     
     int boxID; // unique identifier for this bounding box
@@ -19,19 +33,31 @@ struct BoundingBox { // bounding box around a classified object (contains both 2
     int classID; // ID based on class file provided to YOLO framework
     double confidence; // classification trust
 
-    std::vector<LidarPoint> lidarPoints; // Lidar 3D points which project into 2D image roi
-    std::vector<cv::KeyPoint> keypoints; // keypoints enclosed by 2D roi
-    std::vector<cv::DMatch> kptMatches; // keypoint matches enclosed by 2D roi
+    std::vector<size_t> lidarPointIndices; // indices of the Lidar 3D points which project into 2D image roi in the point cloud of the frame
+    std::vector<size_t> kptMatchIndices; // indices of the keypoint matches enclosed by 2D roi in the matches of the frame
+    LidarRangeStats lidarRange; // distance to the object, computed once the Lidar points are clustered
+};
+
+struct DepthImage { // sparse projection of a Lidar point cloud into the camera image (z-buffer over cells of pixels)
+
+    int cellSize = 1; // edge length of a cell in pixels
+    cv::Size gridSize; // no. of cells along the image columns and rows
+    std::vector<int> cellHead; // index of the nearest (smallest x) point projected into each cell, -1 if none
+    std::vector<int> nextPoint; // index of the next nearest point projected into the same cell, -1 if none
+    std::vector<cv::Point> imagePoints; // pixel coordinates of every point of the cloud
 };
 
 struct DataFrame { // represents the available sensor information at the same time instance
     
     cv::Mat cameraImg; // camera image
+    FrameImages images; // grayscale image and pyramids derived from cameraImg on demand
     
     std::vector<cv::KeyPoint> keypoints; // 2D keypoints within camera image
     cv::Mat descriptors; // keypoint descriptors
     std::vector<cv::DMatch> kptMatches; // keypoint matches between previous and current frame
+    std::vector<cv::Point2f> predictedKeypoints; // keypoint positions expected in the next frame, NaN if unknown
     std::vector<LidarPoint> lidarPoints;
+    DepthImage lidarDepth; // lidarPoints projected into cameraImg
 
     std::vector<BoundingBox> boundingBoxes; // ROI around detected objects in 2D image coordinates
     std::map<int,int> bbMatches; // bounding box matches between previous and current frame
@@ -101,7 +127,7 @@ DECLARE_VARIABLES(MATCHERS, matcher, Matcher);
         action(arg, KNN)
 DECLARE_VARIABLES(SELECTORS, selector, Selector);
 
-inline std::vector<DescriptorType> CompatibleDescriptorTypes(const Descriptor descriptor)
+constexpr bool IsCompatible(const Descriptor descriptor, const DescriptorType descriptor_type)
 {
     switch (descriptor)
     {
@@ -110,20 +136,43 @@ inline std::vector<DescriptorType> CompatibleDescriptorTypes(const Descriptor de
         case descriptor_ORB:
         case descriptor_FREAK:
         case descriptor_AKAZE:
-            return { descriptor_type_BINARY, descriptor_type_HOG, };
+            return true;
         case descriptor_SIFT:
-            return { descriptor_type_HOG, };
+            return descriptor_type == descriptor_type_HOG;
         default:
             throw std::logic_error("some descriptors are not presented in the list of 'case' statements");
     }
 }
 
+inline std::vector<DescriptorType> CompatibleDescriptorTypes(const Descriptor descriptor)
+{
+    std::vector<DescriptorType> descriptor_types;
+    for (auto e_descriptor_type : descriptor_type_array) {
+        if (IsCompatible(descriptor, e_descriptor_type)) {
+            descriptor_types.push_back(e_descriptor_type);
+        }
+    }
+    return descriptor_types;
+}
+
 template <typename T>
 inline const char* ToString(const char* const names[], T index)
 {
     return names[static_cast<size_t>(index)];
 }
 
+// inverse of ToString; throws std::invalid_argument for unknown names
+template <typename T, size_t N>
+inline T FromString(const char* const (&names)[N], const std::string& name)
+{
+    for (size_t i = 0; i < N; ++i) {
+        if (name == names[i]) {
+            return static_cast<T>(i);
+        }
+    }
+    throw std::invalid_argument("unknown name: " + name);
+}
+
 inline std::string ToString(Detector det)
 {
     return ToString(detector_names, det);
@@ -149,4 +198,53 @@ inline std::string ToString(Selector sel)
     return ToString(selector_names, sel);
 }
 
+struct PipelineConfig { // combination of the keypoint detection and matching algorithms the pipeline runs with
+    Detector detector;
+    Descriptor descriptor;
+    DescriptorType descriptor_type;
+    Matcher matcher;
+    Selector selector;
+};
+
+constexpr bool IsCompatible(const Detector detector, const Descriptor descriptor)
+{
+    // AKAZE descriptor extractor works only with key-points detected with KAZE/AKAZE detectors
+    // see https://docs.opencv.org/3.0-beta/modules/features2d/doc/feature_detection_and_description.html#akaze
+
+    // ORB descriptor extractor does not work with the SIFT detetor
+    // see https://answers.opencv.org/question/5542/sift-feature-descriptor-doesnt-work-with-orb-keypoinys/
+    return not ((descriptor == descriptor_AKAZE && detector != detector_AKAZE) ||
+                (descriptor == descriptor_ORB && detector == detector_SIFT));
+}
+
+// all valid combinations in a fixed order (detectors, descriptors, descriptor types, matchers, selectors)
+inline std::vector<PipelineConfig> EnumeratePipelineConfigs()
+{
+    std::vector<PipelineConfig> configs;
+    for (auto e_detector : detector_array) {
+        for (auto e_descriptor : descriptor_array) {
+            if (not IsCompatible(e_detector, e_descriptor)) {
+                continue;
+            }
+
+            for (auto e_descriptor_type : CompatibleDescriptorTypes(e_descriptor)) {
+                for (auto e_matcher : matcher_array) {
+                    for (auto e_selector : selector_array) {
+                        configs.push_back({e_detector, e_descriptor, e_descriptor_type, e_matcher, e_selector});
+                    }
+                }
+            }
+        }
+    }
+
+    return configs;
+}
+
+// unique name of the combination, e.g. SHITOMASI_ORB_BINARY_BF_NN
+inline std::string ToString(const PipelineConfig& config)
+{
+    return ToString(config.detector) + '_' + ToString(config.descriptor) + '_' +
+           ToString(config.descriptor_type) + '_' + ToString(config.matcher) + '_' + ToString(config.selector);
+}
+
 #endif /* dataStructures_h */
@@ -1,6 +1,10 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include "lidarData.hpp"
@@ -53,6 +57,170 @@ void loadLidarFromFile(vector<LidarPoint> &lidarPoints, string filename)
 }
 
 
+bool removeGroundPoints(std::vector<LidarPoint> &lidarPoints, int maxIterations, float distanceTol)
+{
+    // planes tilted by more than ~25 degrees from the horizontal cannot be the road surface
+    const double minNormalZ = 0.9;
+    if (lidarPoints.size() < 3)
+    {
+        return false;
+    }
+
+    // the random generator is seeded with a constant, so that the runs are reproducible
+    cv::RNG rng(0x6c696461);
+    double bestPlane[4] = {0.0, 0.0, 1.0, 0.0};
+    size_t bestInliers = 0;
+    for (int it = 0; it < maxIterations; ++it)
+    {
+        const LidarPoint &p1 = lidarPoints[rng.uniform(0, (int)lidarPoints.size())];
+        const LidarPoint &p2 = lidarPoints[rng.uniform(0, (int)lidarPoints.size())];
+        const LidarPoint &p3 = lidarPoints[rng.uniform(0, (int)lidarPoints.size())];
+
+        // plane through the three sampled points: n * p + d = 0, with the unit normal n pointing upwards
+        const double v1[3] = {p2.x - p1.x, p2.y - p1.y, p2.z - p1.z};
+        const double v2[3] = {p3.x - p1.x, p3.y - p1.y, p3.z - p1.z};
+        double n[3] = {v1[1] * v2[2] - v1[2] * v2[1],
+                       v1[2] * v2[0] - v1[0] * v2[2],
+                       v1[0] * v2[1] - v1[1] * v2[0]};
+        const double norm = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (norm < 1e-9)
+        {
+            continue; // degenerate sample
+        }
+        const double scale = n[2] < 0.0 ? -norm : norm;
+        for (auto &c : n)
+        {
+            c /= scale;
+        }
+        if (n[2] < minNormalZ)
+        {
+            continue;
+        }
+        const double d = -(n[0] * p1.x + n[1] * p1.y + n[2] * p1.z);
+
+        size_t inliers = 0;
+        for (const auto &pt : lidarPoints)
+        {
+            inliers += std::abs(n[0] * pt.x + n[1] * pt.y + n[2] * pt.z + d) <= distanceTol;
+        }
+        if (inliers > bestInliers)
+        {
+            bestInliers = inliers;
+            bestPlane[0] = n[0]; bestPlane[1] = n[1]; bestPlane[2] = n[2]; bestPlane[3] = d;
+        }
+    }
+
+    if (bestInliers == 0)
+    {
+        return false;
+    }
+
+    // signed height above the ground plane
+    lidarPoints.erase(std::remove_if(lidarPoints.begin(), lidarPoints.end(), [&bestPlane, distanceTol](const LidarPoint &pt)
+    {
+        return bestPlane[0] * pt.x + bestPlane[1] * pt.y + bestPlane[2] * pt.z + bestPlane[3] <= distanceTol;
+    }), lidarPoints.end());
+
+    return true;
+}
+
+
+void downsampleLidarPoints(std::vector<LidarPoint> &lidarPoints, float voxelSize)
+{
+    if (voxelSize <= 0.0f)
+    {
+        throw std::invalid_argument("voxel size must be positive");
+    }
+
+    // voxel coordinates are packed into a single 64-bit key, 21 bits per axis
+    const auto voxelKey = [voxelSize](const LidarPoint &pt)
+    {
+        const auto cell = [voxelSize](double v)
+        {
+            return static_cast<uint64_t>(static_cast<int64_t>(std::floor(v / voxelSize)) & 0x1fffff);
+        };
+        return (cell(pt.x) << 42u) | (cell(pt.y) << 21u) | cell(pt.z);
+    };
+
+    // index of the closest point of every voxel
+    std::unordered_map<uint64_t, size_t> closest;
+    closest.reserve(lidarPoints.size());
+    for (size_t i = 0; i < lidarPoints.size(); ++i)
+    {
+        auto res = closest.emplace(voxelKey(lidarPoints[i]), i);
+        if (not res.second and lidarPoints[i].x < lidarPoints[res.first->second].x)
+        {
+            res.first->second = i;
+        }
+    }
+
+    std::vector<bool> keep(lidarPoints.size(), false);
+    for (const auto &voxel : closest)
+    {
+        keep[voxel.second] = true;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < lidarPoints.size(); ++i)
+    {
+        if (keep[i])
+        {
+            lidarPoints[kept++] = lidarPoints[i];
+        }
+    }
+    lidarPoints.resize(kept);
+}
+
+
+
+void projectLidarPoints(const std::vector<LidarPoint> &lidarPoints, const cv::Mat &P_rect_xx, const cv::Mat &R_rect_xx,
+                        const cv::Mat &RT, cv::Size imageSize, int cellSize, DepthImage &depthImage)
+{
+    if (cellSize <= 0)
+    {
+        throw std::invalid_argument("cell size must be positive");
+    }
+
+    depthImage.cellSize = cellSize;
+    depthImage.gridSize = cv::Size((imageSize.width + cellSize - 1) / cellSize, (imageSize.height + cellSize - 1) / cellSize);
+    depthImage.cellHead.assign(depthImage.gridSize.area(), -1);
+    depthImage.nextPoint.assign(lidarPoints.size(), -1);
+    depthImage.imagePoints.resize(lidarPoints.size());
+
+    // the whole projection chain is multiplied out once instead of for every point
+    const cv::Mat proj = P_rect_xx * R_rect_xx * RT;
+    const double *p0 = proj.ptr<double>(0);
+    const double *p1 = proj.ptr<double>(1);
+    const double *p2 = proj.ptr<double>(2);
+
+    for (size_t i = 0; i < lidarPoints.size(); ++i)
+    {
+        const LidarPoint &lpt = lidarPoints[i];
+        const double w = p2[0] * lpt.x + p2[1] * lpt.y + p2[2] * lpt.z + p2[3];
+        const double x = (p0[0] * lpt.x + p0[1] * lpt.y + p0[2] * lpt.z + p0[3]) / w; // pixel coordinates
+        const double y = (p1[0] * lpt.x + p1[1] * lpt.y + p1[2] * lpt.z + p1[3]) / w;
+
+        // checked before rounding to the nearest pixel so that far off points cannot overflow the conversion
+        if (w <= 0.0 or !(x >= -0.5 and y >= -0.5 and x < imageSize.width - 0.5 and y < imageSize.height - 0.5))
+        {
+            continue;
+        }
+        cv::Point &pt = depthImage.imagePoints[i];
+        pt.x = cvRound(x);
+        pt.y = cvRound(y);
+
+        // insertion into the cell's chain keeping it sorted by the distance; chains are a few points long
+        int *link = &depthImage.cellHead[(pt.y / cellSize) * depthImage.gridSize.width + pt.x / cellSize];
+        while (*link >= 0 and lidarPoints[*link].x <= lpt.x)
+        {
+            link = &depthImage.nextPoint[*link];
+        }
+        depthImage.nextPoint[i] = *link;
+        *link = static_cast<int>(i);
+    }
+}
+
+
 void showLidarTopview(std::vector<LidarPoint> &lidarPoints, cv::Size worldSize, cv::Size imageSize, bool bWait)
 {
     // create topview image
@@ -89,7 +257,9 @@ void showLidarTopview(std::vector<LidarPoint> &lidarPoints, cv::Size worldSize,
     }
 }
 
-void showLidarImgOverlay(cv::Mat &img, std::vector<LidarPoint> &lidarPoints, cv::Mat &P_rect_xx, cv::Mat &R_rect_xx, cv::Mat &RT, cv::Mat *extVisImg)
+// draws the points, colored by their distance, at the given pixel coordinates
+static void drawLidarImgOverlay(cv::Mat &img, const std::vector<double> &distances, const std::vector<cv::Point> &imagePoints,
+                                cv::Mat *extVisImg)
 {
     // init image for visualization
     cv::Mat visImg; 
@@ -105,10 +275,35 @@ void showLidarImgOverlay(cv::Mat &img, std::vector<LidarPoint> &lidarPoints, cv:
 
     // find max. x-value
     double maxVal = 0.0; 
-    for(auto it=lidarPoints.begin(); it!=lidarPoints.end(); ++it)
+    for(auto val : distances)
     {
-        maxVal = maxVal<it->x ? it->x : maxVal;
+        maxVal = maxVal<val ? val : maxVal;
+    }
+
+    for(size_t i = 0; i < distances.size(); ++i) {
+            float val = distances[i];
+            int red = min(255, (int)(255 * abs((val - maxVal) / maxVal)));
+            int green = min(255, (int)(255 * (1 - abs((val - maxVal) / maxVal))));
+            cv::circle(overlay, imagePoints[i], 5, cv::Scalar(0, green, red), -1);
+    }
+
+    float opacity = 0.6;
+    cv::addWeighted(overlay, opacity, visImg, 1 - opacity, 0, visImg);
+
+    // return augmented image or wait if no image has been provided
+    if (extVisImg == nullptr)
+    {
+        string windowName = "LiDAR data on image overlay";
+        cv::namedWindow( windowName, 3 );
+        cv::imshow( windowName, visImg );
+        cv::waitKey(0); // wait for key to be pressed
     }
+}
+
+void showLidarImgOverlay(cv::Mat &img, std::vector<LidarPoint> &lidarPoints, cv::Mat &P_rect_xx, cv::Mat &R_rect_xx, cv::Mat &RT, cv::Mat *extVisImg)
+{
+    std::vector<double> distances;
+    std::vector<cv::Point> imagePoints;
 
     cv::Mat X(4,1,cv::DataType<double>::type);
     cv::Mat Y(3,1,cv::DataType<double>::type);
@@ -124,25 +319,23 @@ void showLidarImgOverlay(cv::Mat &img, std::vector<LidarPoint> &lidarPoints, cv:
             pt.x = Y.at<double>(0, 0) / Y.at<double>(2, 0);
             pt.y = Y.at<double>(1, 0) / Y.at<double>(2, 0);
 
-            float val = it->x;
-            int red = min(255, (int)(255 * abs((val - maxVal) / maxVal)));
-            int green = min(255, (int)(255 * (1 - abs((val - maxVal) / maxVal))));
-            cv::circle(overlay, pt, 5, cv::Scalar(0, green, red), -1);
+            distances.push_back(it->x);
+            imagePoints.push_back(pt);
     }
 
-    float opacity = 0.6;
-    cv::addWeighted(overlay, opacity, visImg, 1 - opacity, 0, visImg);
+    drawLidarImgOverlay(img, distances, imagePoints, extVisImg);
+}
 
-    // return augmented image or wait if no image has been provided
-    if (extVisImg == nullptr)
-    {
-        string windowName = "LiDAR data on image overlay";
-        cv::namedWindow( windowName, 3 );
-        cv::imshow( windowName, visImg );
-        cv::waitKey(0); // wait for key to be pressed
-    }
-    else
+void showLidarImgOverlay(cv::Mat &img, const std::vector<LidarPoint> &lidarPoints, const std::vector<size_t> &pointIndices,
+                         const DepthImage &depthImage, cv::Mat *extVisImg)
+{
+    std::vector<double> distances;
+    std::vector<cv::Point> imagePoints;
+    for (auto ind : pointIndices)
     {
-        extVisImg = &visImg;
+        distances.push_back(lidarPoints[ind].x);
+        imagePoints.push_back(depthImage.imagePoints[ind]);
     }
-}
\ No newline at end of file
+
+    drawLidarImgOverlay(img, distances, imagePoints, extVisImg);
+}
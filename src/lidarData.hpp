@@ -11,6 +11,21 @@
 void cropLidarPoints(std::vector<LidarPoint> &lidarPoints, float minX, float maxX, float maxY, float minZ, float maxZ, float minR);
 void loadLidarFromFile(std::vector<LidarPoint> &lidarPoints, std::string filename);
 
+// estimates the ground plane with RANSAC (only nearly horizontal planes are considered) and removes the points
+// lying less than distanceTol above it or anywhere below it; returns false if no plane has been found
+bool removeGroundPoints(std::vector<LidarPoint> &lidarPoints, int maxIterations, float distanceTol);
+// divides the space into cubic voxels with the given edge length and keeps only the point with the smallest x
+// (the closest one in the driving direction) of every voxel; the order of the kept points is preserved
+void downsampleLidarPoints(std::vector<LidarPoint> &lidarPoints, float voxelSize);
+
+// projects the points into the image of the given size once and links each point into the chain of its cell,
+// ordered by the distance x; the points outside of the image are not linked into any cell
+void projectLidarPoints(const std::vector<LidarPoint> &lidarPoints, const cv::Mat &P_rect_xx, const cv::Mat &R_rect_xx,
+                        const cv::Mat &RT, cv::Size imageSize, int cellSize, DepthImage &depthImage);
+
 void showLidarTopview(std::vector<LidarPoint> &lidarPoints, cv::Size worldSize, cv::Size imageSize, bool bWait=true);
 void showLidarImgOverlay(cv::Mat &img, std::vector<LidarPoint> &lidarPoints, cv::Mat &P_rect_xx, cv::Mat &R_rect_xx, cv::Mat &RT, cv::Mat *extVisImg=nullptr);
+// same as above for the subset of the frame's point cloud given by the indices, using the existing projection
+void showLidarImgOverlay(cv::Mat &img, const std::vector<LidarPoint> &lidarPoints, const std::vector<size_t> &pointIndices,
+                         const DepthImage &depthImage, cv::Mat *extVisImg=nullptr);
 #endif /* lidarData_hpp */
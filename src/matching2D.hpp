@@ -8,6 +8,7 @@
 #include <vector>
 #include <cmath>
 #include <limits>
+#include <memory>
 #include <string>
 
 #include <opencv2/core.hpp>
@@ -29,5 +30,48 @@ void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::Key
                       std::vector<cv::DMatch> &matches, std::string descriptorType,
                       std::string matcherType, std::string selectorType);
 
+// SHITOMASI and HARRIS are run by the functions above, all the other detectors by cv::FeatureDetector objects
+constexpr bool IsClassicDetector(const Detector detector)
+{
+  return detector == detector_SHITOMASI or detector == detector_HARRIS;
+}
+
+// norm the descriptors of the given type are compared with
+template <DescriptorType T> struct DescriptorTypeTraits;
+template <> struct DescriptorTypeTraits<descriptor_type_BINARY> { static constexpr int kNorm = cv::NORM_HAMMING; };
+template <> struct DescriptorTypeTraits<descriptor_type_HOG> { static constexpr int kNorm = cv::NORM_L2; };
+
+// whether the matcher requires floating-point descriptors (FLANN does due to a bug in the current OpenCV)
+template <Matcher M> struct MatcherTraits;
+template <> struct MatcherTraits<matcher_BF> { static constexpr bool kFloatDescriptors = false; };
+template <> struct MatcherTraits<matcher_FLANN> { static constexpr bool kFloatDescriptors = true; };
+
+// keypoint detection, description and matching stages of a single combination of algorithms; the implementations
+// are template specializations generated for every valid combination of the DETECTORS, DESCRIPTORS,
+// DESCRIPTOR_TYPES, MATCHERS and SELECTORS lists, so that the properties of the combination are resolved at compile
+// time, and the algorithm objects are created only once
+class KeypointPipeline
+{
+public:
+
+  virtual ~KeypointPipeline() = default;
+
+  virtual void detect(cv::Mat &imgGray, std::vector<cv::KeyPoint> &keypoints) = 0;
+  virtual void describe(std::vector<cv::KeyPoint> &keypoints, cv::Mat &imgGray, cv::Mat &descriptors) = 0;
+
+  // the descriptors are converted in place if the matcher requires another representation
+  virtual void match(cv::Mat &descSource, cv::Mat &descRef, std::vector<cv::DMatch> &matches) = 0;
+
+  // compares each source descriptor only with the reference descriptors whose keypoints lie within searchRadius of
+  // the position the source keypoint is predicted at; the descriptors predicted at NaN are matched globally
+  virtual void matchGuided(const std::vector<cv::Point2f> &predictions, const std::vector<cv::KeyPoint> &kPtsRef,
+                           float searchRadius, cv::Mat &descSource, cv::Mat &descRef,
+                           std::vector<cv::DMatch> &matches) = 0;
+};
+
+// looks the combination up in a dispatch table built at compile time; throws std::invalid_argument
+// for the combinations which are not valid (see EnumeratePipelineConfigs)
+std::unique_ptr<KeypointPipeline> MakeKeypointPipeline(const PipelineConfig &config);
+
 #endif /* matching2D_hpp */
 
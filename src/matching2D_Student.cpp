@@ -1,9 +1,150 @@
+
+#include <algorithm>
+#include <array>
 #include <numeric>
 #include <fstream>
+#include <utility>
 #include "matching2D.hpp"
 
 using namespace std;
 
+// Find the best match for each descriptor in descSource (nearest neighbor)
+static void matchNearestNeighbor(cv::DescriptorMatcher &matcher, cv::Mat &descSource, cv::Mat &descRef,
+                                 std::vector<cv::DMatch> &matches)
+{
+  matcher.match(descSource, descRef, matches); // Finds the best match for each descriptor in desc1
+}
+
+// max. ratio of the distances to the best and the second-best match for the best match to be kept
+constexpr double kMinDescDistRatio = 0.8;
+
+// Find the k=2 best matches for each descriptor in descSource and keep the best one if it passes the ratio test
+static void matchKNearestNeighbors(cv::DescriptorMatcher &matcher, cv::Mat &descSource, cv::Mat &descRef,
+                                   std::vector<cv::DMatch> &matches)
+{
+  int k = 2; // number of neighbours
+  vector<vector<cv::DMatch>> knn_matches;
+  matcher.knnMatch(descSource, descRef, knn_matches, k); // finds the k best matches
+
+  // filter matches using descriptor distance ratio test
+  for (auto& knn_match : knn_matches)
+  {
+    if (knn_match[0].distance < kMinDescDistRatio * knn_match[1].distance)
+    {
+      matches.push_back(knn_match[0]);
+    }
+  }
+}
+
+// Find the best match (NN) or the k=2 best matches passing the ratio test (KNN) for each descriptor in descSource
+// among the descriptors in descRef whose keypoints lie within searchRadius of the predicted position; the reference
+// keypoints are bucketed in a grid of cells of the search radius size, so that only the 3x3 cells around each
+// prediction are scanned. The indices of the source descriptors without a prediction are returned in unplaced.
+static void matchWithinWindows(const std::vector<cv::Point2f> &predictions, const std::vector<cv::KeyPoint> &kPtsRef,
+                               float searchRadius, const cv::Mat &descSource, const cv::Mat &descRef, int normType,
+                               bool bRatioTest, std::vector<cv::DMatch> &matches, std::vector<int> &unplaced)
+{
+  // grid over the bounding rectangle of the reference keypoints
+  cv::Point2f origin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+  cv::Point2f corner(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+  for (const auto &kpt : kPtsRef)
+  {
+    origin.x = std::min(origin.x, kpt.pt.x);
+    origin.y = std::min(origin.y, kpt.pt.y);
+    corner.x = std::max(corner.x, kpt.pt.x);
+    corner.y = std::max(corner.y, kpt.pt.y);
+  }
+  const int gridWidth = kPtsRef.empty() ? 0 : static_cast<int>((corner.x - origin.x) / searchRadius) + 1;
+  const int gridHeight = kPtsRef.empty() ? 0 : static_cast<int>((corner.y - origin.y) / searchRadius) + 1;
+  auto cellOf = [&](const cv::Point2f &pt)
+  {
+    return cv::Point(static_cast<int>(std::floor((pt.x - origin.x) / searchRadius)),
+                     static_cast<int>(std::floor((pt.y - origin.y) / searchRadius)));
+  };
+
+  // counting sort of the reference keypoints by cell: the keypoints of cell c are
+  // cellPoints[cellStart[c]] .. cellPoints[cellStart[c + 1] - 1]
+  std::vector<int> cellStart(static_cast<size_t>(gridWidth) * gridHeight + 1, 0);
+  for (const auto &kpt : kPtsRef)
+  {
+    const cv::Point cell = cellOf(kpt.pt);
+    ++cellStart[cell.y * gridWidth + cell.x + 1];
+  }
+  std::partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+  std::vector<int> cellPoints(kPtsRef.size());
+  std::vector<int> cellFill(cellStart.begin(), cellStart.end() - 1);
+  for (size_t j = 0; j < kPtsRef.size(); ++j)
+  {
+    const cv::Point cell = cellOf(kPtsRef[j].pt);
+    cellPoints[cellFill[cell.y * gridWidth + cell.x]++] = static_cast<int>(j);
+  }
+
+  const float searchRadiusSq = searchRadius * searchRadius;
+  for (int i = 0; i < descSource.rows; ++i)
+  {
+    const cv::Point2f &prediction = predictions[i];
+    if (std::isnan(prediction.x) or std::isnan(prediction.y))
+    {
+      unplaced.push_back(i);
+      continue;
+    }
+
+    // the two nearest descriptors among the reference keypoints within the search window
+    cv::DMatch best(i, -1, std::numeric_limits<float>::max());
+    float secondDistance = std::numeric_limits<float>::max();
+    const cv::Point cell = cellOf(prediction);
+    for (int cy = std::max(cell.y - 1, 0); cy <= std::min(cell.y + 1, gridHeight - 1); ++cy)
+    {
+      for (int cx = std::max(cell.x - 1, 0); cx <= std::min(cell.x + 1, gridWidth - 1); ++cx)
+      {
+        const int c = cy * gridWidth + cx;
+        for (int k = cellStart[c]; k < cellStart[c + 1]; ++k)
+        {
+          const int j = cellPoints[k];
+          const cv::Point2f offset = kPtsRef[j].pt - prediction;
+          if (offset.x * offset.x + offset.y * offset.y > searchRadiusSq)
+          {
+            continue;
+          }
+
+          const auto distance = static_cast<float>(cv::norm(descSource.row(i), descRef.row(j), normType));
+          if (distance < best.distance)
+          {
+            secondDistance = best.distance;
+            best.trainIdx = j;
+            best.distance = distance;
+          }
+          else if (distance < secondDistance)
+          {
+            secondDistance = distance;
+          }
+        }
+      }
+    }
+
+    // a single candidate within the window passes the ratio test
+    if (best.trainIdx >= 0 and (not bRatioTest or best.distance < kMinDescDistRatio * secondDistance))
+    {
+      matches.push_back(best);
+    }
+  }
+}
+
+// OpenCV bug workaround :
+//     convert binary descriptors to floating point due to a bug in current OpenCV implementation
+static void convertToFloatDescriptors(cv::Mat &descSource, cv::Mat &descRef)
+{
+  if (descSource.type() != CV_32F)
+  {
+    descSource.convertTo(descSource, CV_32F);
+  }
+
+  if (descRef.type() != CV_32F)
+  {
+    descRef.convertTo(descRef, CV_32F);
+  }
+}
+
 // Find best matches for keypoints in two camera images based on several matching methods
 void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef,
                       cv::Mat &descSource, cv::Mat &descRef,
@@ -21,53 +162,105 @@ void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::Key
   }
   else if (matcherType == "FLANN")
   {
-    if (descSource.type() != CV_32F)
-    { // OpenCV bug workaround :
-      //     convert binary descriptors to floating point due to a bug in current OpenCV implementation
-      descSource.convertTo(descSource, CV_32F);
-    }
-
-    if (descRef.type() != CV_32F)
-    {
-      descRef.convertTo(descRef, CV_32F);
-    }
-
+    convertToFloatDescriptors(descSource, descRef);
     matcher = cv::DescriptorMatcher::create(cv::DescriptorMatcher::FLANNBASED);
   }
 
   // perform matching task
+  auto t = static_cast<double>(cv::getTickCount());
   if (selectorType == "NN")
   { // nearest neighbor (best match)
-    auto t = static_cast<double>(cv::getTickCount());
-
-    matcher->match(descSource, descRef, matches); // Finds the best match for each descriptor in desc1
-
-    t = (static_cast<double>(cv::getTickCount()) - t) / cv::getTickFrequency();
-    cout << " (NN) with n=" << matches.size() << " matches in " << 1000 * t / 1.0 << " ms" << endl;
+    matchNearestNeighbor(*matcher, descSource, descRef, matches);
   }
   else if (selectorType == "KNN")
   { // k nearest neighbors (k=2)
-    int k = 2; // number of neighbours
-    vector<vector<cv::DMatch>> knn_matches;
-    auto t = static_cast<double>(cv::getTickCount());
+    matchKNearestNeighbors(*matcher, descSource, descRef, matches);
+  }
+  t = (static_cast<double>(cv::getTickCount()) - t) / cv::getTickFrequency();
+  cout << " (" << selectorType << ") with n=" << matches.size() << " matches in " << 1000 * t / 1.0 << " ms" << endl;
+}
 
-    matcher->knnMatch(descSource, descRef, knn_matches, k); // finds the k best matches
+// Descriptor extractors with the parameters used throughout the project
+template <Descriptor D>
+static cv::Ptr<cv::DescriptorExtractor> CreateExtractor();
 
-    t = (static_cast<double>(cv::getTickCount()) - t) / cv::getTickFrequency();
-    cout << " (KNN) with n=" << knn_matches.size() << " matches in " << 1000 * t / 1.0 << " ms" << endl;
+template <>
+cv::Ptr<cv::DescriptorExtractor> CreateExtractor<descriptor_BRISK>()
+{
+  int threshold = 30;        // FAST/AGAST detection threshold score.
+  int octaves = 3;           // detection octaves (use 0 to do single scale)
+  float patternScale = 1.0f; // apply this scale to the pattern used for sampling the neighbourhood of a keypoint.
 
+  return cv::BRISK::create(threshold, octaves, patternScale);
+}
 
-    // filter matches using descriptor distance ratio test
-    double minDescDistRatio = 0.8;
-    for (auto& knn_match : knn_matches)
-    {
-      if (knn_match[0].distance < minDescDistRatio * knn_match[1].distance)
-      {
-        matches.push_back(knn_match[0]);
-      }
-    }
-    cout << "(KNN) # keypoints removed = " << knn_matches.size() - matches.size() << endl;
-  }
+template <>
+cv::Ptr<cv::DescriptorExtractor> CreateExtractor<descriptor_BRIEF>()
+{
+  int bytes = 32;               // legth of the descriptor in bytes
+  bool use_orientation = false; // sample patterns using key points orientation
+
+  return cv::xfeatures2d::BriefDescriptorExtractor::create(bytes, use_orientation);
+}
+
+template <>
+cv::Ptr<cv::DescriptorExtractor> CreateExtractor<descriptor_ORB>()
+{
+  int   nfeatures = 500;     // The maximum number of features to retain.
+  float scaleFactor = 1.2f;  // Pyramid decimation ratio, greater than 1.
+  int   nlevels = 8;         // The number of pyramid levels.
+  int   edgeThreshold = 31;  // This is size of the border where the features are not detected.
+  int   firstLevel = 0;      // The level of pyramid to put source image to.
+  int   WTA_K = 2;           // The number of points that produce each element of the oriented BRIEF descriptor.
+  auto  scoreType = cv::ORB::HARRIS_SCORE; // HARRIS_SCORE / FAST_SCORE algorithm is used to rank features.
+  int   patchSize = 31;      // Size of the patch used by the oriented BRIEF descriptor.
+  int   fastThreshold = 20;  // The FAST threshold.
+
+  return cv::ORB::create(nfeatures, scaleFactor, nlevels, edgeThreshold,
+                         firstLevel, WTA_K, scoreType, patchSize, fastThreshold);
+}
+
+template <>
+cv::Ptr<cv::DescriptorExtractor> CreateExtractor<descriptor_FREAK>()
+{
+  bool orientationNormalized = true; // Enable orientation normalization.
+  bool scaleNormalized = true;       // Enable scale normalization.
+  float patternScale = 22.0f;        // Scaling of the description pattern.
+  int nOctaves = 4;                  // Number of octaves covered by the detected keypoints.
+  const std::vector<int>& selectedPairs = std::vector<int>(); // (Optional) user defined selected pairs indexes.
+
+  return cv::xfeatures2d::FREAK::create(orientationNormalized, scaleNormalized, patternScale,
+                                        nOctaves, selectedPairs);
+}
+
+template <>
+cv::Ptr<cv::DescriptorExtractor> CreateExtractor<descriptor_AKAZE>()
+{
+  // Type of the extracted descriptor: DESCRIPTOR_KAZE, DESCRIPTOR_KAZE_UPRIGHT,
+  //                                   DESCRIPTOR_MLDB or DESCRIPTOR_MLDB_UPRIGHT.
+  auto  descriptor_type = cv::AKAZE::DESCRIPTOR_MLDB;
+  int   descriptor_size = 0;        // Size of the descriptor in bits. 0 -> Full size
+  int   descriptor_channels = 3;    // Number of channels in the descriptor (1, 2, 3).
+  float threshold = 0.001f;         //   Detector response threshold to accept point.
+  int   nOctaves = 4;               // Maximum octave evolution of the image.
+  int   nOctaveLayers = 4;          // Default number of sublevels per scale level.
+  auto  diffusivity = cv::KAZE::DIFF_PM_G2; // Diffusivity type. DIFF_PM_G1, DIFF_PM_G2,
+  //                   DIFF_WEICKERT or DIFF_CHARBONNIER.
+  return cv::AKAZE::create(descriptor_type, descriptor_size, descriptor_channels,
+                           threshold, nOctaves, nOctaveLayers, diffusivity);
+}
+
+template <>
+cv::Ptr<cv::DescriptorExtractor> CreateExtractor<descriptor_SIFT>()
+{
+  int nfeatures = 0; // The number of best features to retain.
+  int nOctaveLayers = 3; // The number of layers in each octave. 3 is the value used in D. Lowe paper.
+  // The contrast threshold used to filter out weak features in semi-uniform (low-contrast) regions.
+  double contrastThreshold = 0.04;
+  double edgeThreshold = 10; // The threshold used to filter out edge-like features.
+  double sigma = 1.6; // The sigma of the Gaussian applied to the input image at the octave \#0.
+
+  return cv::xfeatures2d::SIFT::create(nfeatures, nOctaveLayers, contrastThreshold, edgeThreshold, sigma);
 }
 
 // Use one of several types of state-of-art descriptors to uniquely identify keypoints
@@ -75,76 +268,12 @@ void descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descr
 {
   // select appropriate descriptor
   cv::Ptr<cv::DescriptorExtractor> extractor;
-  if (descriptorType == "BRISK")
+  switch (FromString<Descriptor>(descriptor_names, descriptorType))
   {
-    int threshold = 30;        // FAST/AGAST detection threshold score.
-    int octaves = 3;           // detection octaves (use 0 to do single scale)
-    float patternScale = 1.0f; // apply this scale to the pattern used for sampling the neighbourhood of a keypoint.
-
-    extractor = cv::BRISK::create(threshold, octaves, patternScale);
-  }
-  else if (descriptorType == "BRIEF")
-  {
-    int bytes = 32;               // legth of the descriptor in bytes
-    bool use_orientation = false; // sample patterns using key points orientation
-
-    extractor = cv::xfeatures2d::BriefDescriptorExtractor::create(bytes, use_orientation);
-  }
-  else if (descriptorType == "ORB")
-  {
-    int   nfeatures = 500;     // The maximum number of features to retain.
-    float scaleFactor = 1.2f;  // Pyramid decimation ratio, greater than 1.
-    int   nlevels = 8;         // The number of pyramid levels.
-    int   edgeThreshold = 31;  // This is size of the border where the features are not detected.
-    int   firstLevel = 0;      // The level of pyramid to put source image to.
-    int   WTA_K = 2;           // The number of points that produce each element of the oriented BRIEF descriptor.
-    auto  scoreType = cv::ORB::HARRIS_SCORE; // HARRIS_SCORE / FAST_SCORE algorithm is used to rank features.
-    int   patchSize = 31;      // Size of the patch used by the oriented BRIEF descriptor.
-    int   fastThreshold = 20;  // The FAST threshold.
-
-    extractor = cv::ORB::create(nfeatures, scaleFactor, nlevels, edgeThreshold,
-                                firstLevel, WTA_K, scoreType, patchSize, fastThreshold);
-  }
-  else if (descriptorType == "FREAK")
-  {
-    bool orientationNormalized = true; // Enable orientation normalization.
-    bool scaleNormalized = true;       // Enable scale normalization.
-    float patternScale = 22.0f;        // Scaling of the description pattern.
-    int nOctaves = 4;                  // Number of octaves covered by the detected keypoints.
-    const std::vector<int>& selectedPairs = std::vector<int>(); // (Optional) user defined selected pairs indexes.
-
-    extractor = cv::xfeatures2d::FREAK::create(orientationNormalized, scaleNormalized, patternScale,
-                                               nOctaves, selectedPairs);
-  }
-  else if (descriptorType == "AKAZE")
-  {
-    // Type of the extracted descriptor: DESCRIPTOR_KAZE, DESCRIPTOR_KAZE_UPRIGHT,
-    //                                   DESCRIPTOR_MLDB or DESCRIPTOR_MLDB_UPRIGHT.
-    auto  descriptor_type = cv::AKAZE::DESCRIPTOR_MLDB;
-    int   descriptor_size = 0;        // Size of the descriptor in bits. 0 -> Full size
-    int   descriptor_channels = 3;    // Number of channels in the descriptor (1, 2, 3).
-    float threshold = 0.001f;         //   Detector response threshold to accept point.
-    int   nOctaves = 4;               // Maximum octave evolution of the image.
-    int   nOctaveLayers = 4;          // Default number of sublevels per scale level.
-    auto  diffusivity = cv::KAZE::DIFF_PM_G2; // Diffusivity type. DIFF_PM_G1, DIFF_PM_G2,
-    //                   DIFF_WEICKERT or DIFF_CHARBONNIER.
-    extractor = cv::AKAZE::create(descriptor_type, descriptor_size, descriptor_channels,
-                                  threshold, nOctaves, nOctaveLayers, diffusivity);
-  }
-  else if (descriptorType == "SIFT")
-  {
-    int nfeatures = 0; // The number of best features to retain.
-    int nOctaveLayers = 3; // The number of layers in each octave. 3 is the value used in D. Lowe paper.
-    // The contrast threshold used to filter out weak features in semi-uniform (low-contrast) regions.
-    double contrastThreshold = 0.04;
-    double edgeThreshold = 10; // The threshold used to filter out edge-like features.
-    double sigma = 1.6; // The sigma of the Gaussian applied to the input image at the octave \#0.
-
-    extractor = cv::xfeatures2d::SIFT::create(nfeatures, nOctaveLayers, contrastThreshold, edgeThreshold, sigma);
-  }
-  else
-  {
-    throw std::invalid_argument("unknown descriptor type: " + descriptorType);
+#define CREATE_EXTRACTOR_CASE(_, elem) \
+    case descriptor_##elem: extractor = CreateExtractor<descriptor_##elem>(); break;
+    DESCRIPTORS(CREATE_EXTRACTOR_CASE, EMPTY, EMPTY)
+#undef CREATE_EXTRACTOR_CASE
   }
 
   // perform feature description
@@ -154,8 +283,8 @@ void descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descr
   cout << descriptorType << " descriptor extraction in " << 1000 * t / 1.0 << " ms" << endl;
 }
 
-// Detect keypoints in image using the traditional Shi-Thomasi detector
-void detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis)
+// Shi-Tomasi corners with the parameters used throughout the project
+static void detectShiTomasiCorners(vector<cv::KeyPoint> &keypoints, cv::Mat &img)
 {
   // compute detector parameters based on image size
   int blockSize = 4;       //  size of an average block for computing a derivative covariation matrix over each pixel neighborhood
@@ -167,7 +296,6 @@ void detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool b
   double k = 0.04;
 
   // Apply corner detection
-  auto t = static_cast<double>(cv::getTickCount());
   vector<cv::Point2f> corners{};
   cv::goodFeaturesToTrack(img, corners, maxCorners, qualityLevel, minDistance, cv::Mat(), blockSize, false, k);
 
@@ -180,6 +308,13 @@ void detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool b
     newKeyPoint.size = blockSize;
     keypoints.push_back(newKeyPoint);
   }
+}
+
+// Detect keypoints in image using the traditional Shi-Thomasi detector
+void detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis)
+{
+  auto t = static_cast<double>(cv::getTickCount());
+  detectShiTomasiCorners(keypoints, img);
   t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
   cout << "Shi-Tomasi detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
 
@@ -195,7 +330,8 @@ void detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool b
   }
 }
 
-void detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bool bVis)
+// Harris corners with a non-maximum suppression, with the parameters used throughout the project
+static void detectHarrisCorners(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img)
 {
   // Detector parameters
   int blockSize = 2; // for every pixel, a blockSize × blockSize neighborhood is considered
@@ -205,7 +341,6 @@ void detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bool
   double k = 0.04; // Harris parameter
 
   // Detect Harris corners and normalize output
-  auto t = static_cast<double>(cv::getTickCount());
   cv::Mat dst, dst_norm, dst_norm_scaled;
   dst = cv::Mat::zeros(img.size(), CV_32FC1 );
   cv::cornerHarris( img, dst, blockSize, apertureSize, k, cv::BORDER_DEFAULT );
@@ -248,6 +383,12 @@ void detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bool
       }
     } // end of loop over cols
   } // end of loop over rows
+}
+
+void detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bool bVis)
+{
+  auto t = static_cast<double>(cv::getTickCount());
+  detectHarrisCorners(keypoints, img);
   t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
   cout << "Harris detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
 
@@ -263,66 +404,70 @@ void detKeypointsHarris(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, bool
   }
 }
 
-void detKeypointsModern(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, std::string& detectorType, bool bVis)
+// Feature detectors with the parameters used throughout the project
+template <Detector D>
+static cv::Ptr<cv::FeatureDetector> CreateDetector();
+
+template <>
+cv::Ptr<cv::FeatureDetector> CreateDetector<detector_FAST>()
 {
-  cv::Ptr<cv::FeatureDetector> detector;
-  if (detectorType == "FAST")
-  {
-    int threshold = 30;    // difference between intensity of the central pixel and pixels of a circle around this pixel
-    bool bNMS = true;      // perform non-maxima suppression on keypoints
-    cv::FastFeatureDetector::DetectorType type = cv::FastFeatureDetector::TYPE_9_16; // TYPE_9_16, TYPE_7_12, TYPE_5_8
-    detector = cv::FastFeatureDetector::create(threshold, bNMS, type);
-  }
-  else if (detectorType == "BRISK")
-  {
-    int threshold = 30;        //   AGAST detection threshold score
-    int octaves = 3;           // detection octaves
-    float patternScale = 1.0f; // apply this scale to the pattern used for sampling the neighbourhood of a keypoint
-    detector = cv::BRISK::create(threshold, octaves, patternScale);
-  }
-  else if (detectorType == "ORB")
-  {
-    int   nfeatures = 500;     // The maximum number of features to retain.
-    float scaleFactor = 1.2f;  // Pyramid decimation ratio, greater than 1.
-    int   nlevels = 8;         // The number of pyramid levels.
-    int   edgeThreshold = 31;  // This is size of the border where the features are not detected.
-    int   firstLevel = 0;      // The level of pyramid to put source image to.
-    int   WTA_K = 2;           // The number of points that produce each element of the oriented BRIEF descriptor.
-    auto  scoreType = cv::ORB::HARRIS_SCORE; // HARRIS_SCORE / FAST_SCORE algorithm is used to rank features.
-    int   patchSize = 31;      // Size of the patch used by the oriented BRIEF descriptor.
-    int   fastThreshold = 20;  // The FAST threshold.
-    detector = cv::ORB::create(nfeatures, scaleFactor, nlevels, edgeThreshold,
-                               firstLevel, WTA_K, scoreType, patchSize, fastThreshold);
-  }
-  else if (detectorType == "AKAZE")
+  int threshold = 30;    // difference between intensity of the central pixel and pixels of a circle around this pixel
+  bool bNMS = true;      // perform non-maxima suppression on keypoints
+  cv::FastFeatureDetector::DetectorType type = cv::FastFeatureDetector::TYPE_9_16; // TYPE_9_16, TYPE_7_12, TYPE_5_8
+  return cv::FastFeatureDetector::create(threshold, bNMS, type);
+}
+
+template <>
+cv::Ptr<cv::FeatureDetector> CreateDetector<detector_BRISK>()
+{
+  int threshold = 30;        //   AGAST detection threshold score
+  int octaves = 3;           // detection octaves
+  float patternScale = 1.0f; // apply this scale to the pattern used for sampling the neighbourhood of a keypoint
+  return cv::BRISK::create(threshold, octaves, patternScale);
+}
+
+template <>
+cv::Ptr<cv::FeatureDetector> CreateDetector<detector_ORB>()
+{
+  // ORB detects with the same parameters it describes with
+  return CreateExtractor<descriptor_ORB>();
+}
+
+template <>
+cv::Ptr<cv::FeatureDetector> CreateDetector<detector_AKAZE>()
+{
+  return CreateExtractor<descriptor_AKAZE>();
+}
+
+template <>
+cv::Ptr<cv::FeatureDetector> CreateDetector<detector_SIFT>()
+{
+  return CreateExtractor<descriptor_SIFT>();
+}
+
+// the classic detectors have no cv::FeatureDetector objects
+template <Detector D>
+static cv::Ptr<cv::FeatureDetector> CreateModernDetector()
+{
+  if constexpr (IsClassicDetector(D))
   {
-    // Type of the extracted descriptor: DESCRIPTOR_KAZE, DESCRIPTOR_KAZE_UPRIGHT,
-    //                                   DESCRIPTOR_MLDB or DESCRIPTOR_MLDB_UPRIGHT.
-    auto  descriptor_type = cv::AKAZE::DESCRIPTOR_MLDB;
-    int   descriptor_size = 0;        // Size of the descriptor in bits. 0 -> Full size
-    int   descriptor_channels = 3;    // Number of channels in the descriptor (1, 2, 3).
-    float threshold = 0.001f;         //   Detector response threshold to accept point.
-    int   nOctaves = 4;               // Maximum octave evolution of the image.
-    int   nOctaveLayers = 4;          // Default number of sublevels per scale level.
-    auto  diffusivity = cv::KAZE::DIFF_PM_G2; // Diffusivity type. DIFF_PM_G1, DIFF_PM_G2,
-    //                   DIFF_WEICKERT or DIFF_CHARBONNIER.
-    detector = cv::AKAZE::create(descriptor_type, descriptor_size, descriptor_channels,
-                                 threshold, nOctaves, nOctaveLayers, diffusivity);
+    throw std::invalid_argument(std::string("not a modern detector: ") + detector_names[D]);
   }
-  else if (detectorType == "SIFT")
+  else
   {
-    int nfeatures = 0; // The number of best features to retain.
-    int nOctaveLayers = 3; // The number of layers in each octave. 3 is the value used in D. Lowe paper.
-    // The contrast threshold used to filter out weak features in semi-uniform (low-contrast) regions.
-    double contrastThreshold = 0.04;
-    double edgeThreshold = 10; // The threshold used to filter out edge-like features.
-    double sigma = 1.6; // The sigma of the Gaussian applied to the input image at the octave \#0.
-
-    detector = cv::xfeatures2d::SIFT::create(nfeatures, nOctaveLayers, contrastThreshold, edgeThreshold, sigma);
+    return CreateDetector<D>();
   }
-  else
+}
+
+void detKeypointsModern(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, std::string& detectorType, bool bVis)
+{
+  cv::Ptr<cv::FeatureDetector> detector;
+  switch (FromString<Detector>(detector_names, detectorType))
   {
-    throw std::invalid_argument("unknown detector type: " + detectorType);
+#define CREATE_DETECTOR_CASE(_, elem) \
+    case detector_##elem: detector = CreateModernDetector<detector_##elem>(); break;
+    DETECTORS(CREATE_DETECTOR_CASE, EMPTY, EMPTY)
+#undef CREATE_DETECTOR_CASE
   }
 
   auto t = static_cast<double>(cv::getTickCount());
@@ -340,3 +485,171 @@ void detKeypointsModern(std::vector<cv::KeyPoint>& keypoints, cv::Mat& img, std:
     cv::waitKey(0);
   }
 }
+
+
+template <Detector Det, Descriptor Desc, DescriptorType DescType, Matcher Match, Selector Select>
+class KeypointPipelineImpl final : public KeypointPipeline
+{
+public:
+
+  KeypointPipelineImpl() : extractor_{CreateExtractor<Desc>()}
+  {
+    if constexpr (not IsClassicDetector(Det))
+    {
+      detector_ = CreateDetector<Det>();
+    }
+
+    if constexpr (Match == matcher_BF)
+    {
+      bool crossCheck = false;
+      matcher_ = cv::BFMatcher::create(DescriptorTypeTraits<DescType>::kNorm, crossCheck);
+    }
+    else
+    {
+      matcher_ = cv::DescriptorMatcher::create(cv::DescriptorMatcher::FLANNBASED);
+    }
+  }
+
+  void detect(cv::Mat &imgGray, std::vector<cv::KeyPoint> &keypoints) override
+  {
+    if constexpr (Det == detector_SHITOMASI)
+    {
+      detectShiTomasiCorners(keypoints, imgGray);
+    }
+    else if constexpr (Det == detector_HARRIS)
+    {
+      detectHarrisCorners(keypoints, imgGray);
+    }
+    else
+    {
+      detector_->detect(imgGray, keypoints);
+    }
+  }
+
+  void describe(std::vector<cv::KeyPoint> &keypoints, cv::Mat &imgGray, cv::Mat &descriptors) override
+  {
+    extractor_->compute(imgGray, keypoints, descriptors);
+  }
+
+  void match(cv::Mat &descSource, cv::Mat &descRef, std::vector<cv::DMatch> &matches) override
+  {
+    if constexpr (MatcherTraits<Match>::kFloatDescriptors)
+    {
+      convertToFloatDescriptors(descSource, descRef);
+    }
+
+    if constexpr (Select == selector_NN)
+    {
+      matchNearestNeighbor(*matcher_, descSource, descRef, matches);
+    }
+    else
+    {
+      matchKNearestNeighbors(*matcher_, descSource, descRef, matches);
+    }
+  }
+
+  void matchGuided(const std::vector<cv::Point2f> &predictions, const std::vector<cv::KeyPoint> &kPtsRef,
+                   float searchRadius, cv::Mat &descSource, cv::Mat &descRef, std::vector<cv::DMatch> &matches) override
+  {
+    if (predictions.size() != static_cast<size_t>(descSource.rows) or
+        kPtsRef.size() != static_cast<size_t>(descRef.rows))
+    {
+      throw std::invalid_argument("the keypoints do not correspond to the descriptors");
+    }
+
+    // the descriptors are compared like the global matcher compares them
+    constexpr int normType = MatcherTraits<Match>::kFloatDescriptors ? static_cast<int>(cv::NORM_L2)
+                                                                     : DescriptorTypeTraits<DescType>::kNorm;
+    if constexpr (MatcherTraits<Match>::kFloatDescriptors)
+    {
+      convertToFloatDescriptors(descSource, descRef);
+    }
+
+    std::vector<int> unplaced;
+    matchWithinWindows(predictions, kPtsRef, searchRadius, descSource, descRef, normType, Select == selector_KNN,
+                       matches, unplaced);
+    if (unplaced.empty())
+    {
+      return;
+    }
+
+    // the keypoints without a prediction are matched globally
+    cv::Mat descUnplaced;
+    for (const int i : unplaced)
+    {
+      descUnplaced.push_back(descSource.row(i));
+    }
+    std::vector<cv::DMatch> globalMatches;
+    match(descUnplaced, descRef, globalMatches);
+    for (auto globalMatch : globalMatches)
+    {
+      globalMatch.queryIdx = unplaced[globalMatch.queryIdx];
+      matches.push_back(globalMatch);
+    }
+  }
+
+private:
+
+  cv::Ptr<cv::FeatureDetector> detector_; // nullptr for the classic detectors
+  cv::Ptr<cv::DescriptorExtractor> extractor_;
+  cv::Ptr<cv::DescriptorMatcher> matcher_;
+};
+
+// the combinations are numbered in the mixed radix given by the lengths of the X-macro lists
+constexpr size_t kNumOfPipelineConfigs =
+        num_of_detectors * num_of_descriptors * num_of_descriptor_types * num_of_matchers * num_of_selectors;
+
+static size_t PipelineConfigIndex(const PipelineConfig &config)
+{
+  return (((static_cast<size_t>(config.detector) * num_of_descriptors + config.descriptor) * num_of_descriptor_types +
+           config.descriptor_type) * num_of_matchers + config.matcher) * num_of_selectors + config.selector;
+}
+
+template <size_t I>
+constexpr PipelineConfig PipelineConfigAt()
+{
+  constexpr size_t selector = I % num_of_selectors;
+  constexpr size_t matcher = I / num_of_selectors % num_of_matchers;
+  constexpr size_t descriptor_type = I / num_of_selectors / num_of_matchers % num_of_descriptor_types;
+  constexpr size_t descriptor = I / num_of_selectors / num_of_matchers / num_of_descriptor_types % num_of_descriptors;
+  constexpr size_t detector = I / num_of_selectors / num_of_matchers / num_of_descriptor_types / num_of_descriptors;
+  return {detector_array[detector], descriptor_array[descriptor], descriptor_type_array[descriptor_type],
+          matcher_array[matcher], selector_array[selector]};
+}
+
+using KeypointPipelineFactory = std::unique_ptr<KeypointPipeline> (*)();
+
+// the invalid combinations are not instantiated at all
+template <size_t I>
+static std::unique_ptr<KeypointPipeline> MakeKeypointPipelineAt()
+{
+  constexpr PipelineConfig config = PipelineConfigAt<I>();
+  if constexpr (IsCompatible(config.detector, config.descriptor) and
+                IsCompatible(config.descriptor, config.descriptor_type))
+  {
+    return std::make_unique<KeypointPipelineImpl<config.detector, config.descriptor, config.descriptor_type,
+                                                 config.matcher, config.selector>>();
+  }
+  else
+  {
+    return nullptr;
+  }
+}
+
+template <size_t... I>
+constexpr std::array<KeypointPipelineFactory, sizeof...(I)> MakeDispatchTable(std::index_sequence<I...>)
+{
+  return {&MakeKeypointPipelineAt<I>...};
+}
+
+static constexpr auto kKeypointPipelineFactories = MakeDispatchTable(std::make_index_sequence<kNumOfPipelineConfigs>{});
+
+std::unique_ptr<KeypointPipeline> MakeKeypointPipeline(const PipelineConfig &config)
+{
+  auto pipeline = kKeypointPipelineFactories[PipelineConfigIndex(config)]();
+  if (not pipeline)
+  {
+    throw std::invalid_argument("invalid combination: " + ToString(config));
+  }
+  return pipeline;
+}
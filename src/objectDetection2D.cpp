@@ -2,8 +2,11 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <limits>
+#include <algorithm>
 
 #include <opencv2/dnn.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
@@ -12,118 +15,349 @@
 
 using namespace std;
 
-// detects objects in an image using the YOLO library and a set of pre-trained objects from the COCO database;
-// a set of 80 classes is listed in "coco.names" and pre-trained weights are stored in "yolov3.weights"
-void detectObjects(cv::Mat& img, std::vector<BoundingBox>& bBoxes, float confThreshold, float nmsThreshold, 
-                   std::string basePath, std::string classesFile, std::string modelConfiguration, std::string modelWeights, bool bVis)
+// returns the position of the highest class score in a YOLO output row and stores the score itself in maxScore;
+// the maximum is found with OpenCV universal intrinsics, the position is then recovered by a short scalar scan
+static int argmaxClassScore(const float* scores, const int numScores, float& maxScore)
+{
+    int i = 0;
+    float best = -std::numeric_limits<float>::max();
+#if CV_SIMD || CV_SIMD_SCALABLE
+    // nlanes is deprecated since OpenCV 4.8 and missing for the scalable backends, whose lane count is a run-time value
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 8)
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+#else
+    const int lanes = cv::v_float32::nlanes;
+#endif
+    if (numScores >= lanes)
+    {
+        cv::v_float32 vBest = cv::vx_load(scores);
+        for (i = lanes; i <= numScores - lanes; i += lanes)
+        {
+            vBest = cv::v_max(vBest, cv::vx_load(scores + i));
+        }
+        best = cv::v_reduce_max(vBest);
+    }
+    cv::vx_cleanup();
+#endif
+    for (; i < numScores; ++i)
+    {
+        best = std::max(best, scores[i]);
+    }
+
+    int classId = 0;
+    while (classId < numScores - 1 && scores[classId] != best)
+    {
+        ++classId;
+    }
+
+    maxScore = best;
+    return classId;
+}
+
+void decodeYoloOutputs(const std::vector<cv::Mat>& netOutput, const cv::Size& imgSize, float confThreshold,
+                       std::vector<int>& classIds, std::vector<float>& confidences, std::vector<cv::Rect>& boxes)
+{
+    // candidates decoded from a single output layer; every layer is decoded independently into its own
+    // slot so that the layers can be processed in parallel and concatenated in the original order afterwards
+    struct LayerCandidates
+    {
+        vector<int> classIds;
+        vector<float> confidences;
+        vector<cv::Rect> boxes;
+    };
+    vector<LayerCandidates> layerCandidates(netOutput.size());
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(netOutput.size())), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            const cv::Mat& output = netOutput[i];
+            LayerCandidates& candidates = layerCandidates[i];
+            const int numScores = output.cols - 5;
+
+            for (int j = 0; j < output.rows; ++j)
+            {
+                const float* data = output.ptr<float>(j);
+
+                // the region layer multiplies class probabilities by the objectness score, so no class score
+                // of a row can exceed its objectness; such rows are rejected without looking at the class scores
+                if (data[4] <= confThreshold)
+                {
+                    continue;
+                }
+
+                float confidence;
+                const int classId = argmaxClassScore(data + 5, numScores, confidence);
+                if (confidence > confThreshold)
+                {
+                    cv::Rect box; int cx, cy;
+                    cx = (int)(data[0] * imgSize.width);
+                    cy = (int)(data[1] * imgSize.height);
+                    box.width = (int)(data[2] * imgSize.width);
+                    box.height = (int)(data[3] * imgSize.height);
+                    box.x = cx - box.width/2; // left
+                    box.y = cy - box.height/2; // top
+
+                    candidates.boxes.push_back(box);
+                    candidates.classIds.push_back(classId);
+                    candidates.confidences.push_back(confidence);
+                }
+            }
+        }
+    });
+
+    for (const auto& candidates : layerCandidates)
+    {
+        classIds.insert(classIds.end(), candidates.classIds.begin(), candidates.classIds.end());
+        confidences.insert(confidences.end(), candidates.confidences.begin(), candidates.confidences.end());
+        boxes.insert(boxes.end(), candidates.boxes.begin(), candidates.boxes.end());
+    }
+}
+
+void suppressNonMaxima(const std::vector<cv::Rect>& boxes, const std::vector<float>& confidences,
+                       const std::vector<int>& classIds, float confThreshold, float nmsThreshold, bool bPerClass,
+                       std::vector<int>& indices)
+{
+    if (!bPerClass)
+    {
+        cv::dnn::NMSBoxes(boxes, confidences, confThreshold, nmsThreshold, indices);
+        return;
+    }
+
+    // group candidates by class and suppress overlapping boxes within each class only,
+    // so that, e.g., a person in front of a car does not suppress the car
+    map<int, vector<int>> classMembers;
+    for (size_t i = 0; i < classIds.size(); ++i)
+    {
+        classMembers[classIds[i]].push_back(static_cast<int>(i));
+    }
+
+    vector<cv::Rect> classBoxes;
+    vector<float> classConfidences;
+    vector<int> classIndices;
+    for (const auto& members : classMembers)
+    {
+        classBoxes.clear();
+        classConfidences.clear();
+        classIndices.clear();
+        for (int member : members.second)
+        {
+            classBoxes.push_back(boxes[member]);
+            classConfidences.push_back(confidences[member]);
+        }
+
+        cv::dnn::NMSBoxes(classBoxes, classConfidences, confThreshold, nmsThreshold, classIndices);
+        for (int classIndex : classIndices)
+        {
+            indices.push_back(members.second[classIndex]);
+        }
+    }
+
+    // keep the same ordering as the class-agnostic variant, i.e., the most confident boxes first
+    std::stable_sort(indices.begin(), indices.end(),
+                     [&confidences](const int lhs, const int rhs) { return confidences[lhs] > confidences[rhs]; });
+}
+
+cv::dnn::Net loadYoloNet(const std::string& modelConfiguration, const std::string& modelWeights)
 {
-    // load class names from file
-    vector<string> classes;
-    ifstream ifs(classesFile.c_str());
-    string line;
-    while (getline(ifs, line)) classes.push_back(line);
-    
-    // load neural network
     cv::dnn::Net net = cv::dnn::readNetFromDarknet(modelConfiguration, modelWeights);
     net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
     net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-    
-    // generate 4D blob from input image
-    cv::Mat blob;
-    vector<cv::Mat> netOutput;
-    double scalefactor = 1/255.0;
-    cv::Size size = cv::Size(416, 416);
-    cv::Scalar mean = cv::Scalar(0,0,0);
-    bool swapRB = false;
-    bool crop = false;
-    cv::dnn::blobFromImage(img, blob, scalefactor, size, mean, swapRB, crop);
-    
-    // Get names of output layers
+    return net;
+}
+
+// returns the names of the output layers, i.e., the layers with unconnected outputs
+static vector<cv::String> getOutputLayerNames(const cv::dnn::Net& net)
+{
     vector<cv::String> names;
     vector<int> outLayers = net.getUnconnectedOutLayers(); // get  indices of  output layers, i.e.  layers with unconnected outputs
     vector<cv::String> layersNames = net.getLayerNames(); // get  names of all layers in the network
-    
+
     names.resize(outLayers.size());
     for (size_t i = 0; i < outLayers.size(); ++i) // Get the names of the output layers in names
         names[i] = layersNames[outLayers[i] - 1];
-    
-    // invoke forward propagation through network
-    net.setInput(blob);
-    net.forward(netOutput, names);
-    
-    // Scan through all bounding boxes and keep only the ones with high confidence
-    vector<int> classIds; vector<float> confidences; vector<cv::Rect> boxes;
-    for (size_t i = 0; i < netOutput.size(); ++i)
-    {
-        float* data = (float*)netOutput[i].data;
-        for (int j = 0; j < netOutput[i].rows; ++j, data += netOutput[i].cols)
-        {
-            cv::Mat scores = netOutput[i].row(j).colRange(5, netOutput[i].cols);
-            cv::Point classId;
-            double confidence;
-            
-            // Get the value and location of the maximum score
-            cv::minMaxLoc(scores, 0, &confidence, 0, &classId);
-            if (confidence > confThreshold)
-            {
-                cv::Rect box; int cx, cy;
-                cx = (int)(data[0] * img.cols);
-                cy = (int)(data[1] * img.rows);
-                box.width = (int)(data[2] * img.cols);
-                box.height = (int)(data[3] * img.rows);
-                box.x = cx - box.width/2; // left
-                box.y = cy - box.height/2; // top
-                
-                boxes.push_back(box);
-                classIds.push_back(classId.x);
-                confidences.push_back((float)confidence);
-            }
-        }
-    }
-    
-    // perform non-maxima suppression
-    vector<int> indices;
-    cv::dnn::NMSBoxes(boxes, confidences, confThreshold, nmsThreshold, indices);
+
+    return names;
+}
+
+// converts the candidates which survived non-maxima suppression into bounding boxes
+static void appendBoundingBoxes(const vector<cv::Rect>& boxes, const vector<float>& confidences,
+                                const vector<int>& classIds, const vector<int>& indices, vector<BoundingBox>& bBoxes)
+{
     for(auto it=indices.begin(); it!=indices.end(); ++it) {
-        
+
         BoundingBox bBox;
         bBox.roi = boxes[*it];
         bBox.classID = classIds[*it];
         bBox.confidence = confidences[*it];
         bBox.boxID = (int)bBoxes.size(); // zero-based unique identifier for this bounding box
-        
+
         bBoxes.push_back(bBox);
     }
-    
+}
+
+void detectObjectsBatch(std::vector<cv::Mat>& imgs, std::vector<std::vector<BoundingBox>>& bBoxes,
+                        cv::dnn::Net& net, const cv::Size& inputSize, float confThreshold, float nmsThreshold,
+                        bool bPerClassNMS)
+{
+    bBoxes.resize(imgs.size());
+    if (imgs.empty())
+    {
+        return;
+    }
+
+    // generate a single 4D blob holding all the input images
+    cv::Mat blob;
+    vector<cv::Mat> netOutput;
+    double scalefactor = 1/255.0;
+    cv::Scalar mean = cv::Scalar(0,0,0);
+    bool swapRB = false;
+    bool crop = false;
+    cv::dnn::blobFromImages(imgs, blob, scalefactor, inputSize, mean, swapRB, crop);
+
+    // invoke a single forward propagation through network for the whole batch
+    net.setInput(blob);
+    net.forward(netOutput, getOutputLayerNames(net));
+
+    // split the outputs back into per-image outputs; depending on the OpenCV version, the region layer either
+    // produces a 3D tensor of shape (batch, rows, cols) or stacks the rows of all the images into one 2D matrix
+    const auto batchSize = static_cast<int>(imgs.size());
+    vector<cv::Mat> imgOutput(netOutput.size());
+    for (int b = 0; b < batchSize; ++b)
+    {
+        for (size_t i = 0; i < netOutput.size(); ++i)
+        {
+            cv::Mat& output = netOutput[i];
+            if (output.dims == 3)
+            {
+                imgOutput[i] = cv::Mat(output.size[1], output.size[2], CV_32F, output.ptr<float>(b));
+            }
+            else
+            {
+                const int rowsPerImg = output.rows / batchSize;
+                imgOutput[i] = output.rowRange(b * rowsPerImg, (b + 1) * rowsPerImg);
+            }
+        }
+
+        vector<int> classIds; vector<float> confidences; vector<cv::Rect> boxes;
+        decodeYoloOutputs(imgOutput, imgs[b].size(), confThreshold, classIds, confidences, boxes);
+
+        vector<int> indices;
+        suppressNonMaxima(boxes, confidences, classIds, confThreshold, nmsThreshold, bPerClassNMS, indices);
+        appendBoundingBoxes(boxes, confidences, classIds, indices, bBoxes[b]);
+    }
+}
+
+// detects objects in an image using the YOLO library and a set of pre-trained objects from the COCO database;
+// a set of 80 classes is listed in "coco.names" and pre-trained weights are stored in "yolov3.weights"
+void detectObjects(cv::Mat& img, std::vector<BoundingBox>& bBoxes, float confThreshold, float nmsThreshold, 
+                   std::string basePath, std::string classesFile, std::string modelConfiguration, std::string modelWeights, bool bVis,
+                   bool bPerClassNMS)
+{
+    // load neural network
+    cv::dnn::Net net = loadYoloNet(modelConfiguration, modelWeights);
+
+    detectObjects(img, bBoxes, net, cv::Size(416, 416), confThreshold, nmsThreshold, bPerClassNMS);
+
     // show results
     if(bVis) {
-        
-        cv::Mat visImg = img.clone();
-        for(auto it=bBoxes.begin(); it!=bBoxes.end(); ++it) {
-            
-            // Draw rectangle displaying the bounding box
-            int top, left, width, height;
-            top = (*it).roi.y;
-            left = (*it).roi.x;
-            width = (*it).roi.width;
-            height = (*it).roi.height;
-            cv::rectangle(visImg, cv::Point(left, top), cv::Point(left+width, top+height),cv::Scalar(0, 255, 0), 2);
-            
-            string label = cv::format("%.2f", (*it).confidence);
-            label = classes[((*it).classID)] + ":" + label;
-        
-            // Display label at the top of the bounding box
-            int baseLine;
-            cv::Size labelSize = getTextSize(label, cv::FONT_ITALIC, 0.5, 1, &baseLine);
-            top = max(top, labelSize.height);
-            rectangle(visImg, cv::Point(left, top - round(1.5*labelSize.height)), cv::Point(left + round(1.5*labelSize.width), top + baseLine), cv::Scalar(255, 255, 255), cv::FILLED);
-            cv::putText(visImg, label, cv::Point(left, top), cv::FONT_ITALIC, 0.75, cv::Scalar(0,0,0),1);
-            
-        }
-        
-        string windowName = "Object classification";
-        cv::namedWindow( windowName, 1 );
-        cv::imshow( windowName, visImg );
-        cv::waitKey(0); // wait for key to be pressed
+        showDetectedObjects(img, bBoxes, loadClassNames(classesFile));
     }
 }
+
+void detectObjects(cv::Mat& img, std::vector<BoundingBox>& bBoxes, cv::dnn::Net& net, const cv::Size& inputSize,
+                   float confThreshold, float nmsThreshold, bool bPerClassNMS)
+{
+    // generate 4D blob from input image
+    cv::Mat blob;
+    vector<cv::Mat> netOutput;
+    double scalefactor = 1/255.0;
+    cv::Scalar mean = cv::Scalar(0,0,0);
+    bool swapRB = false;
+    bool crop = false;
+    cv::dnn::blobFromImage(img, blob, scalefactor, inputSize, mean, swapRB, crop);
+    
+    // invoke forward propagation through network
+    net.setInput(blob);
+    net.forward(netOutput, getOutputLayerNames(net));
+    
+    // Scan through all bounding boxes and keep only the ones with high confidence
+    vector<int> classIds; vector<float> confidences; vector<cv::Rect> boxes;
+    decodeYoloOutputs(netOutput, img.size(), confThreshold, classIds, confidences, boxes);
+
+    // perform non-maxima suppression
+    vector<int> indices;
+    suppressNonMaxima(boxes, confidences, classIds, confThreshold, nmsThreshold, bPerClassNMS, indices);
+    appendBoundingBoxes(boxes, confidences, classIds, indices, bBoxes);
+}
+
+std::vector<std::string> loadClassNames(const std::string& classesFile)
+{
+    vector<string> classes;
+    ifstream ifs(classesFile.c_str());
+    string line;
+    while (getline(ifs, line)) classes.push_back(line);
+
+    return classes;
+}
+
+void showDetectedObjects(const cv::Mat& img, const std::vector<BoundingBox>& bBoxes,
+                         const std::vector<std::string>& classes)
+{
+    cv::Mat visImg = img.clone();
+    for(auto it=bBoxes.begin(); it!=bBoxes.end(); ++it) {
+
+        // Draw rectangle displaying the bounding box
+        int top, left, width, height;
+        top = (*it).roi.y;
+        left = (*it).roi.x;
+        width = (*it).roi.width;
+        height = (*it).roi.height;
+        cv::rectangle(visImg, cv::Point(left, top), cv::Point(left+width, top+height),cv::Scalar(0, 255, 0), 2);
+
+        string label = cv::format("%.2f", (*it).confidence);
+        label = classes[((*it).classID)] + ":" + label;
+
+        // Display label at the top of the bounding box
+        int baseLine;
+        cv::Size labelSize = getTextSize(label, cv::FONT_ITALIC, 0.5, 1, &baseLine);
+        top = max(top, labelSize.height);
+        rectangle(visImg, cv::Point(left, top - round(1.5*labelSize.height)), cv::Point(left + round(1.5*labelSize.width), top + baseLine), cv::Scalar(255, 255, 255), cv::FILLED);
+        cv::putText(visImg, label, cv::Point(left, top), cv::FONT_ITALIC, 0.75, cv::Scalar(0,0,0),1);
+
+    }
+
+    string windowName = "Object classification";
+    cv::namedWindow( windowName, 1 );
+    cv::imshow( windowName, visImg );
+    cv::waitKey(0); // wait for key to be pressed
+}
+
+// intersection over union of two rectangles
+static double intersectionOverUnion(const cv::Rect& lhs, const cv::Rect& rhs)
+{
+    const double intersectionArea = (lhs & rhs).area();
+    const double unionArea = lhs.area() + rhs.area() - intersectionArea;
+    return unionArea > 0.0 ? intersectionArea / unionArea : 0.0;
+}
+
+// checks whether every box from the first list overlaps with some box of the same class from the second list
+static bool allBoxesCovered(const std::vector<BoundingBox>& bBoxes, const std::vector<BoundingBox>& otherBBoxes,
+                            double minIoU)
+{
+    return std::all_of(bBoxes.begin(), bBoxes.end(), [&otherBBoxes, minIoU](const BoundingBox& bBox)
+    {
+        return std::any_of(otherBBoxes.begin(), otherBBoxes.end(), [&bBox, minIoU](const BoundingBox& otherBBox)
+        {
+            return bBox.classID == otherBBox.classID && intersectionOverUnion(bBox.roi, otherBBox.roi) >= minIoU;
+        });
+    });
+}
+
+bool boxesDisagree(const std::vector<BoundingBox>& detectedBBoxes, const std::vector<BoundingBox>& trackedBBoxes,
+                   double minIoU)
+{
+    return detectedBBoxes.size() != trackedBBoxes.size() or
+           not allBoxesCovered(detectedBBoxes, trackedBBoxes, minIoU) or
+           not allBoxesCovered(trackedBBoxes, detectedBBoxes, minIoU);
+}
@@ -3,11 +3,47 @@
 #define objectDetection2D_hpp
 
 #include <stdio.h>
+#include <vector>
 #include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
 
 #include "dataStructures.h"
 
+// a YOLO network together with the resolution its input images are resized to
+struct YoloModel
+{
+    std::string configuration; // path to the *.cfg file describing the network
+    std::string weights;       // path to the pre-trained *.weights file
+    cv::Size inputSize;        // network input resolution; both dimensions must be multiples of 32
+};
+
 void detectObjects(cv::Mat& img, std::vector<BoundingBox>& bBoxes, float confThreshold, float nmsThreshold, 
-                   std::string basePath, std::string classesFile, std::string modelConfiguration, std::string modelWeights, bool bVis);
+                   std::string basePath, std::string classesFile, std::string modelConfiguration, std::string modelWeights, bool bVis,
+                   bool bPerClassNMS=false);
+
+void detectObjects(cv::Mat& img, std::vector<BoundingBox>& bBoxes, cv::dnn::Net& net, const cv::Size& inputSize,
+                   float confThreshold, float nmsThreshold, bool bPerClassNMS=false);
+
+cv::dnn::Net loadYoloNet(const std::string& modelConfiguration, const std::string& modelWeights);
+std::vector<std::string> loadClassNames(const std::string& classesFile);
+void showDetectedObjects(const cv::Mat& img, const std::vector<BoundingBox>& bBoxes,
+                         const std::vector<std::string>& classes);
+
+// detects objects in a batch of images with a single forward pass through an already loaded network;
+// bBoxes[i] receives the bounding boxes found in imgs[i]
+void detectObjectsBatch(std::vector<cv::Mat>& imgs, std::vector<std::vector<BoundingBox>>& bBoxes,
+                        cv::dnn::Net& net, const cv::Size& inputSize, float confThreshold, float nmsThreshold,
+                        bool bPerClassNMS=false);
+
+// checks whether two sets of bounding boxes describe different scenes, i.e., whether they differ in the number
+// of boxes or some box has no counterpart of the same class overlapping it by at least minIoU
+bool boxesDisagree(const std::vector<BoundingBox>& detectedBBoxes, const std::vector<BoundingBox>& trackedBBoxes,
+                   double minIoU);
+
+void decodeYoloOutputs(const std::vector<cv::Mat>& netOutput, const cv::Size& imgSize, float confThreshold,
+                       std::vector<int>& classIds, std::vector<float>& confidences, std::vector<cv::Rect>& boxes);
+void suppressNonMaxima(const std::vector<cv::Rect>& boxes, const std::vector<float>& confidences,
+                       const std::vector<int>& classIds, float confThreshold, float nmsThreshold, bool bPerClass,
+                       std::vector<int>& indices);
 
 #endif /* objectDetection2D_hpp */
@@ -0,0 +1,29 @@
+# Runs one combination of 3D_object_tracking on the bundled frames in a scratch directory and checks its results
+# against the golden results of the combination in this directory with regression_check; with UPDATE=1 the results
+# are recorded as the new golden results instead. Invoked by the regression tests and the
+# update_regression_baselines target (see CMakeLists.txt) with
+#   -DTRACKER=... -DCHECKER=... -DCONFIG=... -DDATA_DIR=... -DGOLDEN_DIR=... -DWORK_DIR=...
+#   -DTTC_ABS_TOL=... -DTTC_REL_TOL=... -DMAX_SLOWDOWN=... -DUPDATE=0|1
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+execute_process(COMMAND "${TRACKER}" --config=${CONFIG} --visualize=0 --data=${DATA_DIR}
+                WORKING_DIRECTORY "${WORK_DIR}"
+                RESULT_VARIABLE status)
+if (NOT status EQUAL 0)
+    message(FATAL_ERROR "3D_object_tracking --config=${CONFIG} failed: ${status}")
+endif()
+
+execute_process(COMMAND "${CHECKER}"
+                        --results=${WORK_DIR}/${CONFIG}.csv
+                        --golden=${GOLDEN_DIR}/${CONFIG}.golden.csv
+                        --timing=${GOLDEN_DIR}/${CONFIG}.timing.csv
+                        --ttc-abs-tol=${TTC_ABS_TOL}
+                        --ttc-rel-tol=${TTC_REL_TOL}
+                        --max-slowdown=${MAX_SLOWDOWN}
+                        --update=${UPDATE}
+                RESULT_VARIABLE status)
+if (NOT status EQUAL 0)
+    message(FATAL_ERROR "${CONFIG} deviates from the golden results")
+endif()